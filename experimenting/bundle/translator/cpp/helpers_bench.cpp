@@ -0,0 +1,238 @@
+// helpers_bench.cpp
+// Measures the arithmetic helpers of Visy
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "helpers_bench.hpp"
+
+#include "pieces.hpp"
+#include "arch.hpp"
+#include "cpu.hpp"
+
+#include <cstdint>
+#include <random>
+#include <iomanip>
+#include <functional>
+
+namespace fauces
+{
+
+using Value = std::uint_least64_t;
+
+struct Helper_case
+{
+    const char* operation;
+    bool shift;     // Takes an int as its second operand
+    std::function<bool(Value, Value, unsigned, Value&)> expected;
+};
+
+static Value mask(unsigned bits)
+{
+    return bits == 64 ? ~Value {0} : (Value {1} << bits) - 1;
+}
+
+static std::int_least64_t to_signed(Value v, unsigned bits)
+{
+    if (bits < 64 && v >> (bits - 1) & 1)
+        v |= ~mask(bits);
+    return static_cast<std::int_least64_t>(v);
+}
+
+// Host results, or false for operands the routine need not handle
+static const Helper_case helper_cases[] =
+{
+    {"add", false, [](Value a, Value b, unsigned w, Value& r)
+        {r = (a + b) & mask(w); return true;}},
+    {"sub", false, [](Value a, Value b, unsigned w, Value& r)
+        {r = (a - b) & mask(w); return true;}},
+    {"mul", false, [](Value a, Value b, unsigned w, Value& r)
+        {r = a * b & mask(w); return true;}},
+    {"udiv", false, [](Value a, Value b, unsigned, Value& r)
+        {return b && (r = a / b, true);}},
+    {"umod", false, [](Value a, Value b, unsigned, Value& r)
+        {return b && (r = a % b, true);}},
+    {"div", false, [](Value a, Value b, unsigned w, Value& r)
+        {
+            auto x = to_signed(a, w), y = to_signed(b, w);
+            if (!y || (y == -1 && a == Value {1} << (w - 1)))
+                return false;
+            r = static_cast<Value>(x / y) & mask(w);
+            return true;
+        }},
+    {"mod", false, [](Value a, Value b, unsigned w, Value& r)
+        {
+            auto x = to_signed(a, w), y = to_signed(b, w);
+            if (!y || (y == -1 && a == Value {1} << (w - 1)))
+                return false;
+            r = static_cast<Value>(x % y) & mask(w);
+            return true;
+        }},
+    {"shl", true, [](Value a, Value b, unsigned w, Value& r)
+        {return b < w && (r = a << b & mask(w), true);}},
+    {"shr", true, [](Value a, Value b, unsigned w, Value& r)
+        {return b < w && (r = a >> b, true);}},
+    {"sar", true, [](Value a, Value b, unsigned w, Value& r)
+        {
+            if (b >= w)
+                return false;
+            r = static_cast<Value>(to_signed(a, w) >> b) & mask(w);
+            return true;
+        }}
+};
+
+// A program calling the routine and then stopping, with a system call
+static Linked_program<arch::Visy> helper_program(const string& routine)
+{
+    auto start = make_unique<Translated_unit>();
+    start->code = {0xe1, 0xe1, 0xe1, 0xe1, 0x09, 0xcb, 0x02};
+    Symbol& sym = start->symbols["_start"];
+    sym.pos = 0;
+    sym.size = static_cast<Size>(start->code.size());
+    sym.type = Sym_type::code;
+    sym.references_to_others[routine].emplace_back(Ref_type::four_halfbytes, 0);
+    Supply supply;
+    supply.add_unit(std::move(start));
+    supply.add_unit(arch::Visy::language_library());
+    return supply.link<arch::Visy>();
+}
+
+static constexpr unsigned driver_instructions = 7;
+
+static void write_value(vs::Cpu& cpu, Value address, unsigned bytes, Value v)
+{
+    vs::Address at {static_cast<std::size_t>(address)};
+    switch (bytes)
+    {
+        case 2:
+            cpu.data_ram().write16(at, static_cast<std::uint_least16_t>(v));
+            break;
+        case 4:
+            cpu.data_ram().write32(at, static_cast<std::uint_least32_t>(v));
+            break;
+        default:
+            cpu.data_ram().write64(at, v);
+    }
+}
+
+// Operands of every size of magnitude, and the ones at the limits
+static vector<Value> operands(unsigned bits, std::mt19937_64& random)
+{
+    Value top = Value {1} << (bits - 1);
+    vector<Value> values {0, 1, 2, 3, mask(bits), mask(bits) - 1, top,
+                                                            top - 1, top + 1};
+    while (values.size() < 40)
+    {
+        unsigned length = random() % (bits + 1);
+        Value v = length ? random() & mask(length) : 0;
+        if (random() & 1)
+            v = (~v + 1) & mask(bits);
+        values.push_back(v);
+    }
+    return values;
+}
+
+struct Helper_stats
+{
+    Value min = ~Value {0};
+    Value max = 0;
+    Value total = 0;
+    Value runs = 0;
+};
+
+// Returns false if a result is wrong, after writing it out.
+static bool bench_helper(vs::Cpu& cpu, const Helper_case& c, unsigned bits,
+                        std::mt19937_64& random, std::ostream& out)
+{
+    string routine = string {"__visy_"} + c.operation + std::to_string(bits);
+    Linked_program<arch::Visy> prog = helper_program(routine);
+    cpu.code_ram().load(prog.code_section(), 0);
+    cpu.sdata_ram().load(prog.data_section(), 0);
+    unsigned n = bits / 8;
+    unsigned second = c.shift ? 2 : n;
+    vector<Value> firsts = operands(bits, random);
+    vector<Value> seconds;
+    if (c.shift)
+    {
+        for (Value i = 0; i < bits; ++i)
+            seconds.push_back(i);
+    }
+    else
+        seconds = operands(bits, random);
+    Helper_stats stats;
+    for (Value a: firsts)
+    {
+        for (Value b: seconds)
+        {
+            Value expected;
+            if (!c.expected(a, b, bits, expected))
+                continue;
+            cpu.reset();
+            Value sp = 0x10000 - n - second;
+            cpu.s0() = sp;
+            write_value(cpu, sp, n, a);
+            write_value(cpu, sp + n, second, b);
+            cpu.r0() = a;
+            vs::Trap trap = cpu.loop();
+            if (trap.cause != vs::Trap::Cause::system ||
+                                                    cpu.r0() != expected)
+            {
+                out << std::hex << routine << "(" << a << ", " << b <<
+                    ") = " << cpu.r0() << ", not " << expected << std::dec <<
+                    "\n";
+                return false;
+            }
+            Value count = cpu.instructions() - driver_instructions;
+            stats.min = std::min(stats.min, count);
+            stats.max = std::max(stats.max, count);
+            stats.total += count;
+            ++stats.runs;
+        }
+    }
+    out << std::setw(16) << std::left << routine << std::right <<
+        std::setw(8) << stats.min << std::setw(10) << std::fixed <<
+        std::setprecision(1) << double(stats.total) / stats.runs <<
+        std::setw(8) << stats.max << "\n";
+    return true;
+}
+
+int bench_helpers(std::ostream& out)
+{
+    vs::Cpu cpu {arch::Visy::address_bits};
+    std::mt19937_64 random {1010};
+    out << "routine             min       avg     max  instructions\n";
+    for (unsigned bits: {16, 32, 64})
+    {
+        for (auto& c: helper_cases)
+        {
+            if (!bench_helper(cpu, c, bits, random, out))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace fauces
@@ -27,6 +27,16 @@ SOFTWARE.
 */
 
 #include "files.hpp"
+#include "server.hpp"
+#include "helpers_bench.hpp"
+#include "opt_check.hpp"
+#include "registers_check.hpp"
+#include "run.hpp"
+
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
 
 namespace fauces
 {
@@ -42,10 +52,15 @@ namespace fauces
     {
         vector<Program_input> inputs;
         Program_output output;
+        bool lto;
+        bool run;
+        unsigned profile;       // Hot spots to show, or 0
     };
 
     unordered_map<char, string> expanded = {{'o', "output"}};
-    unordered_map<string, bool> expected_empty = {{"output", false}};
+    unordered_map<string, bool> expected_empty =
+                                    {{"output", false}, {"dep-file", false}, {"lto", true},
+                                     {"run", true}, {"profile", false}};
 
     bool parse_options(Arg_handle& harg)
     {
@@ -68,7 +83,6 @@ namespace fauces
                         else
                         {
                             harg.options[key] = item.substr(2);
-                            ++harg.pos;
                             return true;
                         }
                     }
@@ -76,12 +90,12 @@ namespace fauces
                 harg.options[key] = "";
                 if (!expected_empty.at(key))
                 {
-                    if (harg.pos == harg.argc)
+                    if (harg.pos + 1 == harg.argc)
                         return false;
                     harg.options[key] = harg.argv[harg.pos + 1];
-                    harg.pos += 2;
-                    return true;
+                    ++harg.pos;
                 }
+                return true;
             }
         }
         catch (out_of_range)
@@ -103,24 +117,143 @@ namespace fauces
                 inputs.push_back(input);
             }
         }
-        Program_output output {harg.options.at("output")};
-        Program_arg arg {inputs, output};
+        auto profile = harg.options.find("profile");
+        bool run = harg.options.count("run") || profile != harg.options.end();
+        Program_output output;
+        if (!run || harg.options.count("output"))
+            output.value = harg.options.at("output");
+        auto dep_file = harg.options.find("dep-file");
+        if (dep_file != harg.options.end())
+            output.dep_file = dep_file->second;
+        bool lto = harg.options.count("lto");
+        unsigned top = profile == harg.options.end() ? 0 :
+            static_cast<unsigned>(std::strtoul(profile->second.c_str(),
+                                                                nullptr, 10));
+        Program_arg arg {inputs, output, lto, run, top};
         return arg;
     }
 }
 
+namespace fauces
+{
+    int translate(int argc, char** argv, std::ostream& out, Unit_cache* cache)
+    {
+        Program_arg arg = parse_args(argc, argv);
+        Supply supply;
+        for (auto i = arg.inputs.begin(); i != arg.inputs.end(); ++i)
+        {
+            out << "Input: " << i->value << "\n";
+            if (cache)
+                add_to_supply<arch::Visy>(supply, *i, *cache);
+            else
+                add_to_supply<arch::Visy>(supply, *i);
+        }
+        vector<string> sources = supply.sources();
+        if (arg.lto)
+            supply.optimize_program<arch::Visy>();
+        if (cache)
+            supply.add_unit(cache->language_library<arch::Visy>());
+        else
+            supply.add_unit(arch::Visy::language_library());
+        Linked_program<arch::Visy> prog = supply.link<arch::Visy>();
+        if (!arg.output.value.empty())
+        {
+            save_program<arch::Visy>(prog, arg.output);
+            if (!arg.output.dep_file.empty())
+                save_dependencies(arg.output, sources);
+            out << "Output: " << arg.output.value << "\n";
+        }
+        if (arg.run)
+        {
+            std::uint_least16_t result = run_program(prog, out, arg.profile);
+            out << "Result: 0x" << std::hex << std::setfill('0') <<
+                std::setw(4) << result << std::dec << std::setfill(' ') << "\n";
+            return result;
+        }
+        return 0;
+    }
+}
+
+namespace fauces
+{
+    static bool same_tokens(const list<Token>& a, const list<Token>& b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+            [](const Token& x, const Token& y)
+            {
+                return x.text == y.text && x.type == y.type &&
+                    x.src.path == y.src.path && x.src.lineno == y.src.lineno &&
+                    x.src.col == y.src.col;
+            });
+    }
+
+    // Lexing time of a file with 1 to 16 threads, best of a few runs each.
+    int bench_lexing(const string& path, std::ostream& out)
+    {
+        using clock = std::chrono::steady_clock;
+        constexpr int runs = 5;
+        list<Token> serial = Preprocessor::lex(path, 1);
+        double base = 0;
+        out << "threads      ms  speedup\n";
+        for (unsigned threads: {1, 2, 4, 8, 12, 16})
+        {
+            double best = 0;
+            for (int i = 0; i < runs; ++i)
+            {
+                auto start = clock::now();
+                list<Token> tokens = Preprocessor::lex(path, threads);
+                std::chrono::duration<double, std::milli> t =
+                                                        clock::now() - start;
+                if (!same_tokens(tokens, serial))
+                {
+                    out << "Different tokens with " << threads << " threads\n";
+                    return 1;
+                }
+                if (i == 0 || t.count() < best)
+                    best = t.count();
+            }
+            if (threads == 1)
+                base = best;
+            out << std::setw(7) << threads << std::setw(8) << std::fixed <<
+                std::setprecision(1) << best << std::setw(9) <<
+                std::setprecision(2) << base / best << "\n";
+        }
+        out << serial.size() << " tokens\n";
+        return 0;
+    }
+}
+
+// "--bench-lex file" measures parallel lexing of a file.
+// "--bench-helpers" checks and measures the arithmetic routines of Visy.
+// "--check-opt" checks the optimizations of Visy code in the emulator.
+// "--check-registers" checks the register allocator of Visy.
+// "--serve socket" keeps the translator resident, with loaded units kept
+// between requests. Any other command line is sent to the server named by
+// FAUCES_SERVER, if it is running, or translated right here otherwise.
 int main(int argc, char** argv)
 {
     using std::cout;
-    fauces::Program_arg arg = fauces::parse_args(argc, argv);
-    fauces::Supply supply;
-    for (auto i = arg.inputs.begin(); i != arg.inputs.end(); ++i)
+    if (argc == 3 && std::string {argv[1]} == "--bench-lex")
+        return fauces::bench_lexing(argv[2], cout);
+    if (argc == 2 && std::string {argv[1]} == "--bench-helpers")
+        return fauces::bench_helpers(cout);
+    if (argc == 2 && std::string {argv[1]} == "--check-opt")
+        return fauces::check_optimizations(cout);
+    if (argc == 2 && std::string {argv[1]} == "--check-registers")
+        return fauces::check_registers(cout);
+    if (argc == 3 && std::string {argv[1]} == "--serve")
+    {
+        fauces::Unit_cache cache;
+        fauces::serve(argv[2], [&cache](int n, char** args, std::ostream& out)
+        {
+            return fauces::translate(n, args, out, &cache);
+        });
+    }
+    if (const char* socket_path = std::getenv("FAUCES_SERVER"))
     {
-        cout << "Input: " << i->value << "\n";
-        fauces::add_to_supply<fauces::arch::Visy>(supply, *i);
+        int status;
+        if (fauces::request(socket_path, argc, argv, cout, status))
+            return status;
     }
-    fauces::Linked_program prog = supply.link<fauces::arch::Visy>();
-    fauces::save_program<fauces::arch::Visy>(prog, arg.output);
-    cout << "Output: " << arg.output.value << "\n";
-    return 0;
+    return fauces::translate(argc, argv, cout, nullptr);
 }
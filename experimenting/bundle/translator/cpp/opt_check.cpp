@@ -0,0 +1,205 @@
+// opt_check.cpp
+// Checks the optimizations of Visy code
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "opt_check.hpp"
+
+#include "pieces.hpp"
+#include "arch.hpp"
+#include "cpu.hpp"
+
+#include <cstdint>
+#include <optional>
+
+namespace fauces
+{
+
+using Value = std::uint_least64_t;
+
+// A code symbol, with the symbols it calls at each position inside it
+struct Case_symbol
+{
+    string name;
+    Location pos;
+    Size size;
+    vector<std::pair<string, Location>> calls;
+};
+
+struct Case_unit
+{
+    vector<unsigned char> code;
+    vector<Case_symbol> symbols;
+};
+
+struct Code_case
+{
+    const char* title;
+    vector<Case_unit> units;
+};
+
+static const Code_case code_cases[] =
+{
+    // A label on a dead write must not move past the write that follows.
+    {"label on a dead write",
+        {{{0xc8, 0xc8, 0xc8, 0x0c}, {{"f", 0, 4, {}}, {"L", 1, 3, {}}}}}},
+    {"label on a reload",
+        {{{0xc8, 0xe0, 0xc8, 0xe0, 0x0c}, {{"f", 0, 5, {}}, {"L", 2, 3, {}}}}}},
+    {"label on a push/pop pair",
+        {{{0xc8, 0x90, 0x50, 0xe0, 0x0c}, {{"f", 0, 5, {}}, {"L", 1, 4, {}}}}}},
+    {"label between reloads",
+        {{{0xe2, 0xc8, 0xc8, 0xe2, 0x0c}, {{"f", 0, 5, {}}, {"L", 2, 3, {}}}}}},
+    // Inlining f moves the call to h and the label after it.
+    {"calls inlined across units",
+        {{{0xe1, 0xe1, 0xe1, 0xe1, 0x09, 0xe1, 0xe1, 0xe1, 0xe1, 0x09,
+            0xe2, 0x0c},
+            {{"g", 0, 12, {{"f", 0}, {"h", 5}}}, {"L", 10, 2, {}}}},
+        {{0xe2, 0xe6, 0x0c, 0xe2, 0xe2, 0xe2, 0xe2, 0xe2, 0xe2, 0x0c},
+            {{"f", 0, 3, {}}, {"h", 3, 7, {}}}}}},
+    // Inlined there, f would not find its address in R0. The call is not
+    // right before the return, so that f keeps its address.
+    {"call through R0",
+        {{{0xe0, 0xe0, 0xe0, 0xe0, 0x08, 0xe2, 0x0c},
+            {{"g", 0, 7, {{"f", 0}}}}},
+        {{0xe2, 0x0c}, {{"f", 0, 2, {}}}}}},
+    // Removing the return without turning the call into a jump would run
+    // f, which follows, twice. f is too long to be inlined.
+    {"tail call",
+        {{{0xe1, 0xe1, 0xe1, 0xe1, 0x09, 0x0c,
+            0xe2, 0xe2, 0xe2, 0xe2, 0xe2, 0xe2, 0x0c},
+            {{"g", 0, 6, {{"f", 0}}}, {"f", 6, 7, {}}}}}},
+    // f pops its argument from below its return address, which a jump
+    // would not push.
+    {"tail call after a push",
+        {{{0x9d, 0xe1, 0xe1, 0xe1, 0xe1, 0x09, 0x0c,
+            0x57, 0x5e, 0x97, 0xe2, 0x0c},
+            {{"g", 0, 7, {{"f", 1}}}, {"f", 7, 5, {}}}}}},
+    // Moved through the stack, R0 reaches R1, and R1 comes back to R0
+    // after a change.
+    {"pushd R0, popd R1",
+        {{{0x9d, 0x5f, 0xe3, 0x6a, 0x0c}, {{"g", 0, 5, {}}}}}}
+};
+
+static std::unique_ptr<Translated_unit> case_unit(const Case_unit& c)
+{
+    auto unit = make_unique<Translated_unit>();
+    unit->code = c.code;
+    for (auto& s: c.symbols)
+    {
+        Symbol& sym = unit->symbols[s.name];
+        sym.pos = s.pos;
+        sym.size = s.size;
+        sym.type = Sym_type::code;
+        for (auto& [name, pos]: s.calls)
+            sym.references_to_others[name].emplace_back
+                                                (Ref_type::four_halfbytes, pos);
+    }
+    return unit;
+}
+
+// A program calling a symbol with a value in R0 and then stopping, with a
+// system call
+static void add_driver(Supply& supply, const string& entry)
+{
+    auto start = make_unique<Translated_unit>();
+    start->code = {0xe1, 0xe1, 0xe1, 0xe1, 0x09, 0xcb, 0x02};
+    Symbol& sym = start->symbols["_start"];
+    sym.pos = 0;
+    sym.size = static_cast<Size>(start->code.size());
+    sym.type = Sym_type::code;
+    sym.references_to_others[entry].emplace_back(Ref_type::four_halfbytes, 0);
+    supply.add_unit(std::move(start));
+}
+
+// R0 when the program stops, or nothing if it does not stop as expected
+static std::optional<Value> run(Linked_program<arch::Visy> prog, Value r0)
+{
+    vs::Cpu cpu {arch::Visy::address_bits};
+    cpu.code_ram().load(prog.code_section(), 0);
+    cpu.sdata_ram().load(prog.data_section(), 0);
+    cpu.reset();
+    cpu.r0() = r0;
+    vs::Trap trap = cpu.loop();
+    if (trap.cause != vs::Trap::Cause::system)
+        return {};
+    return cpu.r0();
+}
+
+// The units optimized as the translator does: each one on its own, and then
+// all of them together, as with --lto
+static std::optional<Value> run_case(const Code_case& c, const string& entry,
+                                                    Value r0, bool optimized)
+{
+    Supply supply;
+    add_driver(supply, entry);
+    for (auto& u: c.units)
+    {
+        auto unit = case_unit(u);
+        if (optimized)
+            arch::Visy::optimize(*unit);
+        supply.add_unit(std::move(unit));
+    }
+    if (optimized)
+        supply.optimize_program<arch::Visy>();
+    return run(supply.link<arch::Visy>(), r0);
+}
+
+static bool check_code(const Code_case& c, std::ostream& out)
+{
+    for (auto& u: c.units)
+    {
+        for (auto& sym: u.symbols)
+        {
+            for (Value r0: {Value {0}, Value {0x1234}})
+            {
+                auto before = run_case(c, sym.name, r0, false);
+                auto after = run_case(c, sym.name, r0, true);
+                if (!before || before != after)
+                {
+                    out << c.title << ": entering at " << sym.name <<
+                        " with R0 " << std::hex << r0 << std::dec <<
+                        " changes the result\n";
+                    return false;
+                }
+            }
+        }
+    }
+    out << c.title << ": ok\n";
+    return true;
+}
+
+int check_optimizations(std::ostream& out)
+{
+    for (auto& c: code_cases)
+    {
+        if (!check_code(c, out))
+            return 1;
+    }
+    return 0;
+}
+
+} // namespace fauces
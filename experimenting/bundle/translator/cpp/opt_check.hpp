@@ -0,0 +1,46 @@
+// opt_check.hpp
+// Checks the optimizations of Visy code
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef opt_check_hpp
+#define opt_check_hpp
+
+#include <ostream>
+
+namespace fauces
+{
+
+// Runs small pieces of Visy code in the emulator before and after the
+// optimizations of the architecture, entering them at every symbol, and
+// checks that they leave the same results. Returns the exit status: 1 if an
+// optimization changed what some code does.
+int check_optimizations(std::ostream& out);
+
+} // namespace fauces
+
+#endif /* opt_check_hpp */
@@ -0,0 +1,465 @@
+// registers_check.cpp
+// Checks the register allocator of Visy
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "registers_check.hpp"
+
+#include "pieces.hpp"
+#include "registers.hpp"
+
+#include <cstdint>
+#include <random>
+#include <iomanip>
+
+namespace fauces
+{
+
+using Value = std::uint_least64_t;
+
+// Operations of the programs. In their Alloc_instruction, operand 0 is the
+// source field, operand 1 the destination field and operand 2 the index
+// register added to the source.
+enum class Check_op: std::uint8_t
+{
+    set,    // 1 = constant, as loaded with xorb and sori
+    sori,   // 1 = 1 << 4 | constant
+    xorb,   // 1 ^= 0
+    orb,    // 1 |= 0
+    andb,   // 1 &= 0
+    shr,    // 1 >>= 0
+    notb,   // 1 = ~0
+    lrr,    // 1 = 0
+    lrx,    // 1, an index value, = 0
+    lm,     // 1 = memory at 0 + 2
+    call,   // 1 = f(0), both in R0, destroying every register
+    jmpz,   // To the second successor if 0 is zero, else to the first one
+    out     // 0 is a result of the program
+};
+
+struct Check_step
+{
+    Check_op op;
+    Value constant;
+};
+
+struct Check_program
+{
+    vector<Alloc_block> blocks;
+    vector<vector<Check_step>> steps;   // Of each instruction of each block
+    Vreg count = 0;
+    size_t instructions = 0;
+};
+
+static Alloc_operand read(Vreg v, Phys_reg fixed = Phys_reg::none)
+{
+    return {v, Reg_class::r, true, false, fixed};
+}
+
+static Alloc_operand write(Vreg v, Phys_reg fixed = Phys_reg::none)
+{
+    return {v, Reg_class::r, false, true, fixed};
+}
+
+static Alloc_operand modify(Vreg v)
+{
+    return {v, Reg_class::r, true, true};
+}
+
+// Random programs where a few values live from start to end, changed by
+// straight code, conditionals and loops nested up to some depth
+class Program_maker
+{
+public:
+    Program_maker(Vreg values, std::mt19937_64& random):
+    values {values}, random {random}
+    {}
+    
+    Check_program make()
+    {
+        prog = {};
+        prog.count = values;
+        current = new_block();
+        for (Vreg v = 0; v < values; ++v)
+            set(v, random() & 0xffff);
+        region(2);
+        for (Vreg v = 0; v < values; ++v)
+            add(Check_op::out, {{read(v)}});
+        return std::move(prog);
+    }
+
+private:
+    Vreg values;
+    std::mt19937_64& random;
+    Check_program prog;
+    std::uint32_t current = 0;
+    
+    std::uint32_t new_block()
+    {
+        prog.blocks.emplace_back();
+        prog.steps.emplace_back();
+        return static_cast<std::uint32_t>(prog.blocks.size() - 1);
+    }
+    
+    void add(Check_op op, Alloc_instruction ins, Value constant = 0)
+    {
+        prog.blocks[current].code.push_back(ins);
+        prog.steps[current].push_back({op, constant});
+        ++prog.instructions;
+    }
+    
+    void set(Vreg v, Value constant)
+    {
+        add(Check_op::set, {{Alloc_operand {}, write(v)}}, constant);
+    }
+    
+    Vreg any()
+    {
+        return static_cast<Vreg>(random() % values);
+    }
+    
+    void instruction()
+    {
+        static constexpr Check_op binary[] =
+                {Check_op::xorb, Check_op::orb, Check_op::andb, Check_op::shr};
+        Vreg a = any();
+        Vreg b = any();
+        switch (random() % 10)
+        {
+            case 0:
+                set(b, random() & 0xffff);
+                break;
+            case 1:
+                add(Check_op::sori, {{Alloc_operand {}, modify(b)}},
+                                                            random() & 0xf);
+                break;
+            case 2:
+                add(Check_op::notb, {{read(a), write(b)}});
+                break;
+            case 3:
+            {
+                Alloc_instruction ins {{read(a), write(b)}};
+                ins.is_copy = true;
+                add(Check_op::lrr, ins);
+                break;
+            }
+            case 4:
+            {
+                // Index values are loaded right before they are needed.
+                Vreg x = prog.count++;
+                Vreg base = any();
+                add(Check_op::lrx, {{read(a), {x, Reg_class::x, false, true}}});
+                Alloc_instruction ins {{read(base), write(b),
+                                            {x, Reg_class::x, true, false}}};
+                ins.base = 0;
+                add(Check_op::lm, ins);
+                break;
+            }
+            case 5:
+            {
+                Alloc_instruction ins {{read(a, Phys_reg::r0),
+                                                    write(b, Phys_reg::r0)}};
+                ins.clobbers = 0xf;
+                add(Check_op::call, ins);
+                break;
+            }
+            default:
+                add(binary[random() % 4], {{read(a), modify(b)}});
+        }
+    }
+    
+    void straight()
+    {
+        for (auto n = random() % 6 + 1; n > 0; --n)
+            instruction();
+    }
+    
+    void conditional(unsigned depth)
+    {
+        add(Check_op::jmpz, {{read(any())}});
+        std::uint32_t test = current;
+        std::uint32_t then_first = current = new_block();
+        region(depth);
+        std::uint32_t then_last = current;
+        std::uint32_t else_first = current = new_block();
+        region(depth);
+        std::uint32_t else_last = current;
+        current = new_block();
+        prog.blocks[test].successors = {then_first, else_first};
+        prog.blocks[then_last].successors = {current};
+        prog.blocks[else_last].successors = {current};
+    }
+    
+    // Runs once for every bit of a counter, shifting it out each time.
+    void loop(unsigned depth)
+    {
+        Vreg counter = prog.count++;
+        set(counter, random() % 32);
+        std::uint32_t before = current;
+        std::uint32_t header = current = new_block();
+        prog.blocks[before].successors = {header};
+        add(Check_op::jmpz, {{read(counter)}});
+        std::uint32_t body = current = new_block();
+        region(depth);
+        Vreg one = prog.count++;
+        set(one, 1);
+        add(Check_op::shr, {{read(one), modify(counter)}});
+        prog.blocks[current].successors = {header};
+        current = new_block();
+        prog.blocks[header].successors = {body, current};
+    }
+    
+    void region(unsigned depth)
+    {
+        for (auto n = random() % 3 + 1; n > 0; --n)
+        {
+            auto kind = depth ? random() % 3 : 0;
+            if (kind == 1)
+                conditional(depth - 1);
+            else if (kind == 2)
+                loop(depth - 1);
+            else
+                straight();
+        }
+    }
+};
+
+// Host results of the operations
+static Value compute(const Check_step& step, Value src, Value dst, Value index)
+{
+    switch (step.op)
+    {
+        case Check_op::set:
+            return step.constant;
+        case Check_op::sori:
+            return dst << 4 | step.constant;
+        case Check_op::xorb:
+            return dst ^ src;
+        case Check_op::orb:
+            return dst | src;
+        case Check_op::andb:
+            return dst & src;
+        case Check_op::shr:
+            return dst >> (src & 63);
+        case Check_op::notb:
+            return ~src;
+        case Check_op::lm:
+            // Any memory contents will do, as long as they are the same.
+            return (src + index) * 0x9e37'79b9'7f4a'7c15 >> 7;
+        case Check_op::call:
+            return (src ^ 0x5555) * 0xff51'afd7'ed55'8ccd;
+        default:
+            return src;
+    }
+}
+
+static vector<Value> run_virtual(const Check_program& prog)
+{
+    vector<Value> v(prog.count);
+    vector<Value> results;
+    std::uint32_t b = 0;
+    for (;;)
+    {
+        auto& code = prog.blocks[b].code;
+        bool zero = false;
+        for (size_t i = 0; i < code.size(); ++i)
+        {
+            auto& ops = code[i].operands;
+            auto& step = prog.steps[b][i];
+            auto value = [&](int n)
+            {
+                return ops[n].reg == no_vreg ? 0 : v[ops[n].reg];
+            };
+            if (step.op == Check_op::jmpz)
+                zero = value(0) == 0;
+            else if (step.op == Check_op::out)
+                results.push_back(value(0));
+            else
+                v[ops[1].reg] = compute(step, value(0), value(1), value(2));
+        }
+        auto& successors = prog.blocks[b].successors;
+        if (successors.empty())
+            return results;
+        b = successors[zero && successors.size() > 1];
+    }
+}
+
+struct Machine
+{
+    std::array<Value, 4> regs {};
+    vector<Value> slots;
+    
+    void apply(const Fixup& fixup)
+    {
+        auto reg = static_cast<unsigned>(fixup.reg);
+        switch (fixup.kind)
+        {
+            case Fixup_kind::spill:
+                slots.at(fixup.slot) = regs.at(reg);
+                break;
+            case Fixup_kind::reload:
+                regs.at(reg) = slots.at(fixup.slot);
+                break;
+            case Fixup_kind::move:
+                regs.at(static_cast<unsigned>(fixup.other)) = regs.at(reg);
+                break;
+            case Fixup_kind::swap:
+                std::swap(regs[0], regs[1]);
+                break;
+        }
+    }
+};
+
+// Whether the registers of an instruction are the ones it can use
+static bool valid(const Alloc_instruction& ins,
+                                        const std::array<Phys_reg, 3>& regs)
+{
+    for (int n = 0; n < 3; ++n)
+    {
+        auto& op = ins.operands[n];
+        if (op.reg == no_vreg)
+            continue;
+        unsigned r = static_cast<unsigned>(regs[n]);
+        unsigned first = op.cls == Reg_class::r ? 0 : 2;
+        if (r < first || r >= first + 2 ||
+                            (op.fixed != Phys_reg::none && op.fixed != regs[n]))
+            return false;
+    }
+    // Xn is only added to Rn.
+    return ins.base < 0 || ins.operands[2].reg == no_vreg ||
+            static_cast<unsigned>(regs[2]) ==
+                                    (static_cast<unsigned>(regs[ins.base]) ^ 2);
+}
+
+// The results, or an empty vector if a register cannot be used where the
+// allocation puts it
+static vector<Value> run_allocated(const Check_program& prog,
+                                                    const Allocation& alloc)
+{
+    Machine m;
+    m.slots.resize(alloc.slots);
+    vector<Value> results;
+    std::uint32_t b = 0;
+    for (;;)
+    {
+        auto& code = prog.blocks[b].code;
+        auto& allocated = alloc.blocks[b];
+        auto fixup = allocated.fixups.begin();
+        bool zero = false;
+        for (size_t i = 0; i < code.size(); ++i)
+        {
+            for (; fixup != allocated.fixups.end() && fixup->before == i;
+                                                                    ++fixup)
+                m.apply(*fixup);
+            auto& regs = allocated.operands.at(i);
+            if (!valid(code[i], regs))
+                return {};
+            auto& ops = code[i].operands;
+            auto& step = prog.steps[b][i];
+            auto value = [&](int n)
+            {
+                return ops[n].reg == no_vreg ? 0 :
+                                        m.regs[static_cast<unsigned>(regs[n])];
+            };
+            if (step.op == Check_op::jmpz)
+                zero = value(0) == 0;
+            else if (step.op == Check_op::out)
+                results.push_back(value(0));
+            else
+            {
+                Value v = compute(step, value(0), value(1), value(2));
+                for (unsigned r = 0; r < 4; ++r)
+                {
+                    if (code[i].clobbers & (1u << r))
+                        m.regs[r] = 0xdead'dead'dead'dead;
+                }
+                m.regs[static_cast<unsigned>(regs[1])] = v;
+            }
+        }
+        for (; fixup != allocated.fixups.end(); ++fixup)
+            m.apply(*fixup);
+        auto& successors = prog.blocks[b].successors;
+        if (successors.empty())
+            return results;
+        auto next = successors[zero && successors.size() > 1];
+        for (auto& edge: alloc.edges)
+        {
+            if (edge.from == b && edge.to == next)
+            {
+                for (auto& f: edge.fixups)
+                    m.apply(f);
+            }
+        }
+        b = next;
+    }
+}
+
+int check_registers(std::ostream& out)
+{
+    constexpr unsigned programs = 1000;
+    std::mt19937_64 random {1010};
+    out << "values  instructions  spills  reloads   moves  coalesced\n";
+    for (Vreg values: {1, 2, 3, 4, 6, 8})
+    {
+        Program_maker maker {values, random};
+        size_t instructions = 0;
+        Allocation total;
+        for (unsigned p = 0; p < programs; ++p)
+        {
+            Check_program prog = maker.make();
+            Allocation alloc;
+            try
+            {
+                alloc = allocate_registers(prog.blocks, prog.count);
+            }
+            catch (Limit_error& e)
+            {
+                out << "Program " << p << " with " << values <<
+                    " values: " << e.msg << "\n";
+                return 1;
+            }
+            if (run_allocated(prog, alloc) != run_virtual(prog))
+            {
+                out << "Program " << p << " with " << values <<
+                    " values: wrong allocation\n";
+                return 1;
+            }
+            instructions += prog.instructions;
+            total.spills += alloc.spills;
+            total.reloads += alloc.reloads;
+            total.moves += alloc.moves;
+            total.coalesced += alloc.coalesced;
+        }
+        out << std::setw(6) << values << std::setw(14) << instructions <<
+            std::setw(8) << total.spills << std::setw(9) << total.reloads <<
+            std::setw(8) << total.moves << std::setw(11) << total.coalesced <<
+            "\n";
+    }
+    return 0;
+}
+
+} // namespace fauces
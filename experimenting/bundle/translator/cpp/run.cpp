@@ -0,0 +1,56 @@
+// run.cpp
+// Runs linked programs in the emulator
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "run.hpp"
+
+#include "environment.hpp"
+
+namespace fauces
+{
+
+std::uint_least16_t run_program(Linked_program<arch::Visy>& prog,
+                                    std::ostream& console, unsigned profile_top)
+{
+    prog.verify();
+    vs::Environment env {arch::Visy::address_bits, console};
+    if (profile_top)
+    {
+        vs::Symbol_names names;
+        for (const auto& [name, symbol]: prog.symbols())
+        {
+            if (symbol.type == Sym_type::code)
+                names.emplace(symbol.pos, name);
+        }
+        env.profile(console, profile_top, std::move(names));
+    }
+    env.run(prog.code_section(), prog.data_section());
+    return env.result();
+}
+
+} // namespace fauces
@@ -0,0 +1,55 @@
+// run.hpp
+// Runs linked programs in the emulator
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef run_hpp
+#define run_hpp
+
+#include "pieces.hpp"
+#include "arch.hpp"
+
+#include <cstdint>
+#include <ostream>
+
+namespace fauces
+{
+
+// Runs a program in the emulator of the virtual system straight from the
+// sections of its image in memory, with no file in between, and returns the
+// code it leaves with. The program is verified first, as if it were saved,
+// so unresolved references are reported instead of run. Exceptions of the
+// emulator, such as the ones for unsupported system calls, are let through.
+// What the program writes to the console goes to console. If profile_top is
+// not 0, a profile of the program with that many hot spots, named after its
+// symbols, follows it.
+std::uint_least16_t run_program(Linked_program<arch::Visy>& prog,
+                            std::ostream& console, unsigned profile_top = 0);
+
+} // namespace fauces
+
+#endif /* run_hpp */
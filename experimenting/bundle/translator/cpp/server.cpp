@@ -0,0 +1,279 @@
+// server.cpp
+// Resident translation server
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "server.hpp"
+
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <exception>
+#include <typeinfo>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cxxabi.h>
+
+namespace fauces
+{
+
+// Every message is a sequence of fields. Numbers are 32-bit, most significant
+// byte first. Strings are their size followed by their bytes.
+//
+// Request: number of strings, working directory, arguments.
+// Reply: status of the request, exit status, output, error.
+//
+// The error is what the runtime would print about the exception that made a
+// failed request fail, had it not been caught, and is empty otherwise.
+
+enum class Request_status: std::uint32_t {done, failed};
+
+class Connection
+{
+public:
+    explicit Connection(int fd): fd {fd} {}
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+    ~Connection()
+    {
+        close(fd);
+    }
+    
+    void put(std::uint32_t n)
+    {
+        unsigned char b[4] {static_cast<unsigned char>(n >> 24),
+                            static_cast<unsigned char>(n >> 16),
+                            static_cast<unsigned char>(n >> 8),
+                            static_cast<unsigned char>(n)};
+        put_bytes(b, sizeof b);
+    }
+    
+    void put(const std::string& s)
+    {
+        put(static_cast<std::uint32_t>(s.size()));
+        put_bytes(s.data(), s.size());
+    }
+    
+    std::uint32_t get_number()
+    {
+        unsigned char b[4];
+        get_bytes(b, sizeof b);
+        return std::uint32_t(b[0]) << 24 | std::uint32_t(b[1]) << 16 |
+                                        std::uint32_t(b[2]) << 8 | b[3];
+    }
+    
+    std::string get_string()
+    {
+        std::string s(get_number(), '\0');
+        get_bytes(s.data(), s.size());
+        return s;
+    }
+
+private:
+    int fd;
+    
+    void put_bytes(const void* data, std::size_t size)
+    {
+        auto p = static_cast<const char*>(data);
+        while (size)
+        {
+            ssize_t n = write(fd, p, size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                throw Server_error_protocol();
+            p += n;
+            size -= n;
+        }
+    }
+    
+    void get_bytes(void* data, std::size_t size)
+    {
+        auto p = static_cast<char*>(data);
+        while (size)
+        {
+            ssize_t n = read(fd, p, size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                throw Server_error_protocol();
+            p += n;
+            size -= n;
+        }
+    }
+};
+
+static sockaddr_un socket_address(const std::string& socket_path)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof address.sun_path)
+        throw Server_error_socket();
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return address;
+}
+
+// Called from a handler, like the terminate handler does
+static std::string uncaught_message()
+{
+    std::string message = "terminate called after throwing an instance of '";
+    if (const std::type_info* type = abi::__cxa_current_exception_type())
+    {
+        int demangled;
+        char* name = abi::__cxa_demangle(type->name(), nullptr, nullptr,
+                                                                    &demangled);
+        message += demangled == 0 ? name : type->name();
+        std::free(name);
+    }
+    message += "'\n";
+    try
+    {
+        throw;
+    }
+    catch (const std::exception& e)
+    {
+        message += std::string {"  what():  "} + e.what() + "\n";
+    }
+    catch (...)
+    {
+    }
+    return message;
+}
+
+static void answer(Connection& conn, Translate_function& translate)
+{
+    std::uint32_t count = conn.get_number();
+    if (count == 0)
+        throw Server_error_protocol();
+    std::string cwd = conn.get_string();
+    std::vector<std::string> args;
+    for (std::uint32_t i = 1; i < count; ++i)
+        args.push_back(conn.get_string());
+    std::vector<char*> argv;
+    for (auto& a: args)
+        argv.push_back(a.data());
+    argv.push_back(nullptr);
+
+    std::ostringstream out;
+    int status = 1;
+    Request_status result = Request_status::done;
+    std::string error;
+    // The translation library may write to the standard output on its own,
+    // and that belongs to the client too.
+    std::streambuf* cout_buffer = std::cout.rdbuf(out.rdbuf());
+    try
+    {
+        std::filesystem::current_path(cwd);
+        status = translate(static_cast<int>(args.size()), argv.data(), out);
+    }
+    catch (...)
+    {
+        result = Request_status::failed;
+        error = uncaught_message();
+    }
+    std::cout.rdbuf(cout_buffer);
+    conn.put(static_cast<std::uint32_t>(result));
+    conn.put(static_cast<std::uint32_t>(status));
+    conn.put(out.str());
+    conn.put(error);
+}
+
+void serve(const std::string& socket_path, Translate_function translate)
+{
+    // Clients going away must not take the server with them.
+    std::signal(SIGPIPE, SIG_IGN);
+    sockaddr_un address = socket_address(socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw Server_error_socket();
+    Connection listener {fd};
+    unlink(socket_path.c_str());
+    // Whoever can connect runs the translator as us, so only we can.
+    mode_t mask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
+    int bound = bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof address);
+    umask(mask);
+    if (bound < 0 || listen(fd, SOMAXCONN) < 0)
+        throw Server_error_socket();
+    for (;;)
+    {
+        int client = accept(fd, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            throw Server_error_socket();
+        }
+        Connection conn {client};
+        try
+        {
+            answer(conn, translate);
+        }
+        catch (Server_error_protocol)
+        {
+            // The client went away. Nothing to do about it.
+        }
+    }
+}
+
+bool request(const std::string& socket_path, int argc, char** argv,
+                                            std::ostream& out, int& status)
+{
+    sockaddr_un address = socket_address(socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    Connection conn {fd};
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) < 0)
+        return false;
+    conn.put(static_cast<std::uint32_t>(argc + 1));
+    conn.put(std::filesystem::current_path().string());
+    for (int i = 0; i < argc; ++i)
+        conn.put(std::string {argv[i]});
+    auto result = static_cast<Request_status>(conn.get_number());
+    status = static_cast<int>(conn.get_number());
+    out << conn.get_string();
+    out.flush();
+    std::string error = conn.get_string();
+    if (result != Request_status::done)
+    {
+        std::cerr << error;
+        std::abort();
+    }
+    return true;
+}
+
+} // namespace fauces
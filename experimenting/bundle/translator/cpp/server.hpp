@@ -0,0 +1,63 @@
+// server.hpp
+// Resident translation server
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef server_hpp
+#define server_hpp
+
+#include <string>
+#include <ostream>
+#include <functional>
+
+namespace fauces
+{
+
+// Translates one command line, writing to out what would otherwise be written
+// to the standard output, and returns the exit status.
+using Translate_function = std::function<int(int, char**, std::ostream&)>;
+
+struct Server_error_socket {};
+struct Server_error_protocol {};
+
+// Accepts translation requests on a local socket, one at a time, and never
+// returns unless the socket fails. Each request is run by translate inside
+// the working directory of the client. Only the user running the server may
+// connect to the socket.
+void serve(const std::string& socket_path, Translate_function translate);
+
+// Runs a command line in the server listening on socket_path, copying its
+// output to out. Returns false, without doing anything, if there is no server.
+// A request that fails inside the server makes the client abort, like an
+// uncaught exception would do, after writing what the runtime would write
+// about it.
+bool request(const std::string& socket_path, int argc, char** argv,
+                                            std::ostream& out, int& status);
+
+} // namespace fauces
+
+#endif /* server_hpp */
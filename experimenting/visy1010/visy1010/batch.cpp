@@ -0,0 +1,230 @@
+// batch.cpp
+// Runs many executables at once
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "batch.hpp"
+#include "environment.hpp"
+#include "exec.hpp"
+
+#include "using_containers.hpp"
+#include "using_cstdint.hpp"
+#include "using_iostream.hpp"
+#include "using_string.hpp"
+
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace vs
+{
+
+namespace
+{
+
+// Indices of tasks, split among threads, each of which takes them from the
+// front of its own queue and, once it is empty, from the back of the queues
+// of the others. Tasks are never added while running.
+class Work_queues
+{
+public:
+    Work_queues(std::size_t tasks, unsigned threads) : queues(threads)
+    {
+        // Consecutive tasks, which tend to take similar time, go to the same
+        // queue, so stealing evens out runs of long ones
+        for (std::size_t i = 0; i < tasks; ++i)
+            queues[i * threads / tasks].tasks.push_back(i);
+    }
+    
+    bool take(unsigned thread, std::size_t& task)
+    {
+        {
+            Queue& own = queues[thread];
+            std::lock_guard lock {own.mutex};
+            if (!own.tasks.empty())
+            {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < queues.size(); ++i)
+        {
+            Queue& other = queues[(thread + i) % queues.size()];
+            std::lock_guard lock {other.mutex};
+            if (!other.tasks.empty())
+            {
+                task = other.tasks.back();
+                other.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+    
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+    
+    vector<Queue> queues;
+};
+
+Batch_result run_task(const Batch_task& task, unsigned bits)
+{
+    using clock = std::chrono::steady_clock;
+    Batch_result result;
+    auto start = clock::now();
+    // Tasks share no console: what they write is lost, and they read nothing.
+    std::ostream discarded {nullptr};
+    std::istringstream no_input;
+    try
+    {
+        string path = task.path;
+        Program prog {path.data()};
+        Environment env {bits, discarded, discarded, no_input};
+        env.run(prog.code(), prog.data());
+        result.ok = env.left();
+        result.exit_code = env.result();
+        result.instructions = env.instructions();
+        if (!result.ok)
+            result.error = "unimplemented instruction";
+    }
+    catch (Program_loading_error& e)
+    {
+        result.error = e.msg;
+    }
+    catch (Unsupported_trap& e)
+    {
+        std::ostringstream msg;
+        msg << "unsupported system call 0x" << hex << e.code;
+        result.error = msg.str();
+    }
+    catch (Unsupported_format&)
+    {
+        result.error = "unsupported format of system call";
+    }
+    catch (std::ios_base::failure&)
+    {
+        result.error = "cannot read the executable";
+    }
+    catch (std::exception& e)
+    {
+        result.error = e.what();
+    }
+    std::chrono::duration<double> t = clock::now() - start;
+    result.seconds = t.count();
+    return result;
+}
+
+} // namespace
+
+vector<Batch_task> read_manifest(istream& is)
+{
+    vector<Batch_task> tasks;
+    string line;
+    while (std::getline(is, line))
+    {
+        std::istringstream words {line};
+        Batch_task task;
+        if (!(words >> task.path) || task.path[0] == '#')
+            continue;
+        string argument;
+        while (words >> argument)
+            task.arguments.push_back(argument);
+        tasks.push_back(std::move(task));
+    }
+    return tasks;
+}
+
+vector<Batch_result> run_batch(const vector<Batch_task>& tasks, unsigned bits,
+                                                                unsigned threads)
+{
+    vector<Batch_result> results(tasks.size());
+    if (tasks.empty())
+        return results;
+    threads = std::max(1u, std::min<unsigned>(threads,
+                                static_cast<unsigned>(tasks.size())));
+    Work_queues queues {tasks.size(), threads};
+    auto work = [&](unsigned thread)
+    {
+        std::size_t task;
+        while (queues.take(thread, task))
+            results[task] = run_task(tasks[task], bits);
+    };
+    vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i)
+        workers.emplace_back(work, i);
+    work(0);
+    for (auto& worker: workers)
+        worker.join();
+    return results;
+}
+
+bool print_results(ostream& out, const vector<Batch_task>& tasks,
+                                        const vector<Batch_result>& results)
+{
+    std::size_t failed = 0;
+    uint_least64_t instructions = 0;
+    double seconds = 0;
+    out << "  exit  instructions        ms  executable\n";
+    for (std::size_t i = 0; i < tasks.size(); ++i)
+    {
+        const Batch_result& r = results[i];
+        if (r.ok)
+        {
+            out << "0x" << hex << setfill('0') << setw(4) << r.exit_code <<
+                                                        dec << setfill(' ');
+        }
+        else
+            out << " error";
+        out << ' ' << setw(13) << r.instructions << ' ' << std::fixed <<
+            std::setprecision(3) << setw(9) << r.seconds * 1e3 << "  " <<
+                                                                tasks[i].path;
+        for (const auto& argument: tasks[i].arguments)
+            out << ' ' << argument;
+        if (!r.ok)
+            out << "  (" << r.error << ")";
+        out << '\n';
+        if (!r.ok || r.exit_code != 0)
+            ++failed;
+        instructions += r.instructions;
+        seconds += r.seconds;
+    }
+    out << tasks.size() << " executables, " << failed << " failed, " <<
+        instructions << " instructions in " << std::setprecision(3) <<
+                                                seconds << " s of threads\n";
+    return failed == 0;
+}
+
+} // namespace vs
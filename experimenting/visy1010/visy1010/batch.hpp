@@ -0,0 +1,74 @@
+// batch.hpp
+// Runs many executables at once
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef fauvisy_batch_hpp
+#define fauvisy_batch_hpp
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace vs
+{
+
+// An executable to run, with its arguments, which are shown with its results
+// but not passed to it, as Environment has no way to pass them yet
+struct Batch_task
+{
+    std::string path;
+    std::vector<std::string> arguments;
+};
+
+struct Batch_result
+{
+    bool ok = false;                    // Left through the system call
+    std::uint_least16_t exit_code = 0;
+    std::uint_least64_t instructions = 0;
+    double seconds = 0;
+    std::string error;                  // Why it did not run to its end
+};
+
+// One task per line: the path of the executable and then its arguments,
+// separated by spaces. Empty lines and lines starting with # are skipped.
+std::vector<Batch_task> read_manifest(std::istream& is);
+
+// Runs every task in its own Environment of bits address bits, with its
+// console output discarded, on threads threads that take tasks from their
+// own queues and steal from the others when theirs is empty.
+std::vector<Batch_result> run_batch(const std::vector<Batch_task>& tasks,
+                                            unsigned bits, unsigned threads);
+
+// A line per task, with its exit code, instructions, time and executable,
+// and then a summary. Returns whether every task left with code 0.
+bool print_results(std::ostream& out, const std::vector<Batch_task>& tasks,
+                                    const std::vector<Batch_result>& results);
+
+} // namespace vs
+
+#endif /* fauvisy_batch_hpp */
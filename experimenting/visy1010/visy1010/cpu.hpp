@@ -30,22 +30,30 @@ SOFTWARE.
 #ifndef fauvisy_cpu_hpp
 #define fauvisy_cpu_hpp
 
+#include <algorithm>
 #include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <set>
+#include <vector>
 
 #include "processor.hpp"
 #include "memory.hpp"
-#include "parser.hpp"
 
 namespace vs
 {
 
-class Cpu: public Processor
+class Cpu final: public Processor
 {
 public:
+    // Memories are only committed as they are used, so bits can go as far as
+    // the address space of the host allows. Beyond it, throws std::bad_alloc.
     Cpu(unsigned bits) :
-    cram(1ULL << bits),
-    dram(1ULL << bits),
-    pm((1ULL << bits) - 1)
+    cram(memory_size(bits)),
+    dram(memory_size(bits)),
+    pm(memory_size(bits) - 1),
+    decoded(memory_size(bits))
     {}
     
     void reset()
@@ -54,30 +62,225 @@ public:
         r[0] = r[1] = 0;
         s[0] = s[1] = 0;
         s[0] = s[1] = 0;
+        executed = 0;
     }
     
-    void loop()
+    // Runs until a trap, which is returned rather than thrown, so that the
+    // environment can handle system calls and go on for a few nanoseconds.
+    // Code RAM is decoded a page at a time when it is first run after it may
+    // have changed, so each instruction jumps straight to the next one
+    // without parsing it again.
+    Trap loop()
     {
-        running = true;
-        while (running)
+        return runs ? run<true>() : run<false>();
+    }
+    
+    // From now on, counts how many times the instruction at each address of
+    // code runs and how many times each address is called, slowing down the
+    // loop. Without it, the loop does not count at all.
+    void start_profile()
+    {
+        if (!runs)
         {
-            std::uint_least64_t instruction_pc = pc;
-            ++pc;
-            parse_instruction(*this, cram[instruction_pc & pm]);
+            runs = std::make_unique<Zero_pages<std::uint_least64_t>>(pm + 1);
+            calls = std::make_unique<Zero_pages<std::uint_least64_t>>(pm + 1);
+            // Decoded again, so that pages_run sees them.
+            decoded.clear();
+            any_decoded = false;
         }
     }
     
-    void stop()
+    bool profiling() const
+    {
+        return runs != nullptr;
+    }
+    
+    std::uint_least64_t pointer_mask() const
+    {
+        return pm;
+    }
+    
+    // Since start_profile
+    std::uint_least64_t runs_at(std::uint_least64_t addr) const
+    {
+        return runs ? (*runs)[addr & pm] : 0;
+    }
+    
+    std::uint_least64_t calls_to(std::uint_least64_t addr) const
     {
-        running = false;
+        return calls ? (*calls)[addr & pm] : 0;
     }
     
+    static constexpr std::uint_least64_t page_size = 0x1000;
+    
+    // First addresses of the pages of code where something ran or was called
+    // since start_profile, so that reports need not look anywhere else
+    const std::set<std::uint_least64_t>& pages_run() const
+    {
+        return run_pages;
+    }
+    
+private:
+    template<bool profiled>
+    Trap run()
+    {
+        const Decoded* i;
+        [[maybe_unused]] std::uint_least64_t* ran =
+                                        profiled ? runs->data() : nullptr;
+        [[maybe_unused]] std::uint_least64_t* called =
+                                        profiled ? calls->data() : nullptr;
+        
+        // Past the rest of a fused sequence, once its first instruction is
+        // counted
+#define VS_SKIP \
+        if constexpr (profiled) \
+        { \
+            for (unsigned k = 0; k + 1u < i->length; ++k) \
+                ++ran[(pc + k) & pm]; \
+        } \
+        pc += i->length - 1u; \
+        executed += i->length - 1u
+#if defined(__GNUC__)
+        // In the order of Op
+        static const void* const handlers[] =
+        {
+            &&op_undecoded, &&op_unimplemented, &&op_sys, &&op_jmp, &&op_call, &&op_ret,
+            &&op_jmpz, &&op_jmpnz,
+            &&op_lmb, &&op_lmh, &&op_lmw, &&op_lmd,
+            &&op_popb, &&op_popb_r, &&op_poph, &&op_poph_r,
+            &&op_popw, &&op_popw_r, &&op_popd, &&op_popd_r,
+            &&op_lrx, &&op_pops, &&op_pops_s, &&op_lrr, &&op_lrs, &&op_lsr,
+            &&op_stmb, &&op_stmh, &&op_stmw, &&op_stmd,
+            &&op_pushb, &&op_pushb_r, &&op_pushh, &&op_pushh_r,
+            &&op_pushw, &&op_pushw_r, &&op_pushd, &&op_pushd_r,
+            &&op_pushs, &&op_pushs_s, &&op_strr, &&op_strs, &&op_stsr,
+            &&op_andb, &&op_orb, &&op_xorb, &&op_notb, &&op_least,
+            &&op_shl, &&op_shr, &&op_sori,
+            &&op_sori_run, &&op_not_sori_run, &&op_constant,
+            &&op_pushb_pair, &&op_pushh_pair, &&op_pushw_pair, &&op_pushd_pair,
+            &&op_popb_pair, &&op_poph_pair, &&op_popw_pair, &&op_popd_pair
+        };
+#define VS_OP(name) op_##name:
+#define VS_NEXT \
+        i = &decoded[pc & pm]; \
+        if constexpr (profiled) \
+            ++ran[pc & pm]; \
+        ++pc; \
+        ++executed; \
+        goto *handlers[static_cast<unsigned>(i->op)]
+        VS_NEXT;
+#else
+#define VS_OP(name) case Op::name:
+#define VS_NEXT continue
+        for (;;)
+        {
+            i = &decoded[pc & pm];
+            if constexpr (profiled)
+                ++ran[pc & pm];
+            ++pc;
+            ++executed;
+            switch (i->op)
+            {
+#endif
+        VS_OP(undecoded)
+            if constexpr (profiled)
+                --ran[(pc - 1) & pm];
+            decode_page();
+            VS_NEXT;
+        VS_OP(unimplemented) return unimplemented_trap();
+        VS_OP(sys) return {Trap::Cause::system, R(i->s), R(i->d), 0, 0};
+        VS_OP(jmp) jmp(R(i->d)); VS_NEXT;
+        VS_OP(call)
+            call(R(i->d));
+            if constexpr (profiled)
+                ++called[pc & pm];
+            VS_NEXT;
+        VS_OP(ret) ret(); VS_NEXT;
+        VS_OP(jmpz) jmpz(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(jmpnz) jmpnz(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(lmb) lmb(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(lmh) lmh(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(lmw) lmw(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(lmd) lmd(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(popb) popb(); VS_NEXT;
+        VS_OP(popb_r) popb(R(i->d)); VS_NEXT;
+        VS_OP(poph) poph(); VS_NEXT;
+        VS_OP(poph_r) poph(R(i->d)); VS_NEXT;
+        VS_OP(popw) popw(); VS_NEXT;
+        VS_OP(popw_r) popw(R(i->d)); VS_NEXT;
+        VS_OP(popd) popd(); VS_NEXT;
+        VS_OP(popd_r) popd(R(i->d)); VS_NEXT;
+        VS_OP(lrx) lrx(R(i->s), X(i->d)); VS_NEXT;
+        VS_OP(pops) pops(); VS_NEXT;
+        VS_OP(pops_s) pops(S(i->d)); VS_NEXT;
+        VS_OP(lrr) lrr(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(lrs) lrs(R(i->s), S(i->d)); VS_NEXT;
+        VS_OP(lsr) lsr(S(i->s), R(i->d)); VS_NEXT;
+        VS_OP(stmb) stmb(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(stmh) stmh(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(stmw) stmw(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(stmd) stmd(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(pushb) pushb(); VS_NEXT;
+        VS_OP(pushb_r) pushb(R(i->s)); VS_NEXT;
+        VS_OP(pushh) pushh(); VS_NEXT;
+        VS_OP(pushh_r) pushh(R(i->s)); VS_NEXT;
+        VS_OP(pushw) pushw(); VS_NEXT;
+        VS_OP(pushw_r) pushw(R(i->s)); VS_NEXT;
+        VS_OP(pushd) pushd(); VS_NEXT;
+        VS_OP(pushd_r) pushd(R(i->s)); VS_NEXT;
+        VS_OP(pushs) pushs(); VS_NEXT;
+        VS_OP(pushs_s) pushs(S(i->s)); VS_NEXT;
+        VS_OP(strr) strr(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(strs) strs(R(i->s), S(i->d)); VS_NEXT;
+        VS_OP(stsr) stsr(S(i->s), R(i->d)); VS_NEXT;
+        VS_OP(andb) andb(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(orb) orb(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(xorb) xorb(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(notb) notb(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(least) least(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(shl) shl(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(shr) shr(R(i->s), R(i->d)); VS_NEXT;
+        VS_OP(sori) sori(Imme(i->s), R(i->d)); VS_NEXT;
+        VS_OP(sori_run)
+            r[i->d] = i->s < 16 ? (r[i->d] << 4 * i->s) | i->value : i->value;
+            VS_SKIP;
+            VS_NEXT;
+        VS_OP(not_sori_run)
+            r[i->d] = i->s < 16 ? (~r[i->d] << 4 * i->s) | i->value : i->value;
+            VS_SKIP;
+            VS_NEXT;
+        VS_OP(constant) r[i->d] = i->value; VS_SKIP; VS_NEXT;
+        VS_OP(pushb_pair) pushb(R(i->s)); pushb(R(i->d)); VS_SKIP; VS_NEXT;
+        VS_OP(pushh_pair) pushh(R(i->s)); pushh(R(i->d)); VS_SKIP; VS_NEXT;
+        VS_OP(pushw_pair) pushw(R(i->s)); pushw(R(i->d)); VS_SKIP; VS_NEXT;
+        VS_OP(pushd_pair) pushd(R(i->s)); pushd(R(i->d)); VS_SKIP; VS_NEXT;
+        VS_OP(popb_pair) popb(R(i->s)); popb(R(i->d)); VS_SKIP; VS_NEXT;
+        VS_OP(poph_pair) poph(R(i->s)); poph(R(i->d)); VS_SKIP; VS_NEXT;
+        VS_OP(popw_pair) popw(R(i->s)); popw(R(i->d)); VS_SKIP; VS_NEXT;
+        VS_OP(popd_pair) popd(R(i->s)); popd(R(i->d)); VS_SKIP; VS_NEXT;
+#if !defined(__GNUC__)
+            }
+        }
+#endif
+#undef VS_OP
+#undef VS_NEXT
+#undef VS_SKIP
+    }
+    
+public:
+    
+    // Its contents are decoded again before running them.
     Memory& code_ram()
     {
+        if (any_decoded)
+        {
+            decoded.clear();
+            any_decoded = false;
+        }
         return cram;
     }
     
-    Memory& sdata_ram()
+    Guarded_memory_be& sdata_ram()
     {
         return dram;
     }
@@ -121,8 +324,266 @@ public:
     {
         return x[1];
     }
+    
+    // Since the last reset
+    std::uint_least64_t instructions() const
+    {
+        return executed;
+    }
 
 private:
+    friend class Snapshot;
+    
+    // What an instruction does, with its variants apart. Each variant that
+    // names a register follows the one that does not. Pages of decoded not
+    // decoded yet are zeros, which are undecoded.
+    enum class Op: std::uint_least8_t
+    {
+        undecoded, unimplemented, sys, jmp, call, ret, jmpz, jmpnz,
+        lmb, lmh, lmw, lmd,
+        popb, popb_r, poph, poph_r, popw, popw_r, popd, popd_r,
+        lrx, pops, pops_s, lrr, lrs, lsr,
+        stmb, stmh, stmw, stmd,
+        pushb, pushb_r, pushh, pushh_r, pushw, pushw_r, pushd, pushd_r,
+        pushs, pushs_s, strr, strs, stsr,
+        andb, orb, xorb, notb, least, shl, shr, sori,
+        
+        // Fused sequences
+        sori_run, not_sori_run, constant,
+        pushb_pair, pushh_pair, pushw_pair, pushd_pair,
+        popb_pair, poph_pair, popw_pair, popd_pair
+    };
+    
+    // An instruction of code RAM, ready to run, or a sequence of them that
+    // starts there. s is the immediate for sori and the number of nibbles
+    // for runs of sori; pairs keep their registers in s and d.
+    struct Decoded
+    {
+        Op op;
+        std::uint_least8_t s;
+        std::uint_least8_t d;
+        std::uint_least8_t length = 1;      // Of the sequence
+        std::uint_least64_t value = 0;      // Of the nibbles of runs of sori
+    };
+    
+    static Op next_variant(Op op)
+    {
+        return static_cast<Op>(static_cast<unsigned>(op) + 1);
+    }
+    
+    static Decoded decode(std::uint_least8_t instruction)
+    {
+        constexpr Op none = Op::unimplemented;
+        static constexpr Op ops[64] =
+        {
+            Op::sys, Op::jmp, Op::call, Op::ret,
+            Op::jmpz, Op::jmpnz, none, none,
+            none, none, none, none,
+            none, none, none, none,
+            
+            Op::lmb, Op::lmh, Op::lmw, Op::lmd,
+            Op::popb, Op::poph, Op::popw, Op::popd,
+            Op::lrx, Op::pops, Op::lrr, Op::lrs,
+            Op::lsr, none, none, none,
+            
+            Op::stmb, Op::stmh, Op::stmw, Op::stmd,
+            Op::pushb, Op::pushh, Op::pushw, Op::pushd,
+            none, Op::pushs, Op::strr, Op::strs,
+            Op::stsr, none, none, none,
+            
+            Op::andb, Op::orb, Op::xorb, Op::notb,
+            Op::least, Op::shl, Op::shr, none,
+            Op::sori, Op::sori, Op::sori, Op::sori,
+            Op::sori, Op::sori, Op::sori, Op::sori
+        };
+        Decoded decoded {ops[instruction >> 2 & 0x3f],
+            static_cast<std::uint_least8_t>(instruction >> 1 & 1),
+            static_cast<std::uint_least8_t>(instruction & 1)};
+        switch (decoded.op)
+        {
+            case Op::jmp:
+            case Op::call:
+                if (decoded.s)
+                    decoded.op = Op::unimplemented;
+                break;
+            case Op::ret:
+                if (instruction & 3)
+                    decoded.op = Op::unimplemented;
+                break;
+            case Op::popb:
+            case Op::poph:
+            case Op::popw:
+            case Op::popd:
+            case Op::pops:
+                if (instruction & 2)
+                    decoded.op = next_variant(decoded.op);
+                break;
+            case Op::pushb:
+            case Op::pushh:
+            case Op::pushw:
+            case Op::pushd:
+            case Op::pushs:
+                if (instruction & 1)
+                    decoded.op = next_variant(decoded.op);
+                break;
+            case Op::sori:
+                decoded.s = instruction >> 1 & 0xf;
+                break;
+            default:
+                break;
+        }
+        return decoded;
+    }
+    
+    // Nibbles that the next instruction puts into register d, if it is one
+    // sori or a run of them
+    static bool sori_run_of(const Decoded& next, unsigned d,
+                                unsigned& nibbles, std::uint_least64_t& value)
+    {
+        if (next.d != d)
+            return false;
+        if (next.op == Op::sori)
+        {
+            nibbles = 1;
+            value = next.s;
+            return true;
+        }
+        if (next.op == Op::sori_run)
+        {
+            nibbles = next.s;
+            value = next.value;
+            return true;
+        }
+        return false;
+    }
+    
+    // Joins an instruction with the sequence decoded at the next address, if
+    // together they are a sequence that runs as one: loads of constants, as
+    // the assembler writes them, and pairs of pushes or pops of the same
+    // size. Every address keeps its own record, so a jump into a sequence
+    // runs its remaining instructions as if nothing had been joined.
+    static void fuse(Decoded& first, const Decoded& next)
+    {
+        constexpr unsigned max_length = 32;
+        if (next.length >= max_length)
+            return;
+        auto length = static_cast<std::uint_least8_t>(next.length + 1);
+        unsigned nibbles;
+        std::uint_least64_t value;
+        switch (first.op)
+        {
+            case Op::sori:
+                if (sori_run_of(next, first.d, nibbles, value))
+                {
+                    if (nibbles < 16)
+                        value |= std::uint_least64_t {first.s} << 4 * nibbles++;
+                    first = {Op::sori_run,
+                        static_cast<std::uint_least8_t>(nibbles), first.d,
+                        length, value};
+                }
+                break;
+            case Op::notb:
+                if (first.s == first.d &&
+                                sori_run_of(next, first.d, nibbles, value))
+                {
+                    first = {Op::not_sori_run,
+                        static_cast<std::uint_least8_t>(nibbles), first.d,
+                        length, value};
+                }
+                break;
+            case Op::xorb:
+                if (first.s != first.d)
+                    break;
+                if (sori_run_of(next, first.d, nibbles, value))
+                    first = {Op::constant, 0, first.d, length, value};
+                else if (next.op == Op::not_sori_run && next.d == first.d)
+                {
+                    value = next.value;
+                    if (next.s < 16)
+                        value |= ~std::uint_least64_t {0} << 4 * next.s;
+                    first = {Op::constant, 0, first.d, length, value};
+                }
+                break;
+            case Op::pushb_r:
+            case Op::pushh_r:
+            case Op::pushw_r:
+            case Op::pushd_r:
+                if (next.op == first.op)
+                    first = {paired(first.op), first.s, next.s, length};
+                break;
+            case Op::popb_r:
+            case Op::poph_r:
+            case Op::popw_r:
+            case Op::popd_r:
+                if (next.op == first.op)
+                    first = {paired(first.op), first.d, next.d, length};
+                break;
+            default:
+                break;
+        }
+    }
+    
+    static Op paired(Op op)
+    {
+        switch (op)
+        {
+            case Op::pushb_r:
+                return Op::pushb_pair;
+            case Op::pushh_r:
+                return Op::pushh_pair;
+            case Op::pushw_r:
+                return Op::pushw_pair;
+            case Op::pushd_r:
+                return Op::pushd_pair;
+            case Op::popb_r:
+                return Op::popb_pair;
+            case Op::poph_r:
+                return Op::poph_pair;
+            case Op::popw_r:
+                return Op::popw_pair;
+            default:
+                return Op::popd_pair;
+        }
+    }
+    
+    static std::size_t memory_size(unsigned bits)
+    {
+        if (bits >= std::numeric_limits<std::size_t>::digits)
+            throw std::bad_alloc();
+        return std::size_t {1} << bits;
+    }
+    
+    // Decodes the page of the instruction just fetched, which was undecoded,
+    // and leaves the program counter at it again. From the end, so that each
+    // instruction finds the next one decoded. Sequences do not go past the
+    // end of code RAM, where the program counter wraps around, nor into a
+    // following page not decoded yet.
+    void decode_page()
+    {
+        --pc;
+        --executed;
+        std::uint_least64_t first = pc & pm & ~(page_size - 1);
+        std::uint_least64_t last = first + std::min(page_size - 1, pm);
+        if (runs)
+            run_pages.insert(first);
+        decoded[last] = decode(cram[last]);
+        if (last != pm)
+            fuse(decoded[last], decoded[last + 1]);
+        for (std::uint_least64_t i = last; i-- > first;)
+        {
+            decoded[i] = decode(cram[static_cast<std::size_t>(i)]);
+            fuse(decoded[i], decoded[i + 1]);
+        }
+        any_decoded = true;
+    }
+    
+    Trap unimplemented_trap()
+    {
+        std::size_t addr = static_cast<std::size_t>((pc - 1) & pm);
+        return {Trap::Cause::unimplemented, R(0), R(0), addr, cram[addr]};
+    }
+    
+    // Only for callers of Processor, since loop does not throw
     void unimplemented() override
     {
         std::size_t addr = static_cast<std::size_t>((pc - 1) & pm);
@@ -139,20 +600,17 @@ private:
         if (pm >> 32)
         {
             s[0] -= 8;
-            dram.write64(Address {s[0] & pm},
-                                    static_cast<std::uint_least64_t>(pc & pm));
+            dram.put64(s[0] & pm, static_cast<std::uint_least64_t>(pc & pm));
         }
         else if (pm >> 16)
         {
             s[0] -= 4;
-            dram.write32(Address {s[0] & pm},
-                                    static_cast<std::uint_least32_t>(pc & pm));
+            dram.put32(s[0] & pm, static_cast<std::uint_least32_t>(pc & pm));
         }
         else
         {
             s[0] -= 2;
-            dram.write16(Address {s[0] & pm},
-                                    static_cast<std::uint_least16_t>(pc & pm));
+            dram.put16(s[0] & pm, static_cast<std::uint_least16_t>(pc & pm));
         }
         pc = r[dst];
     }
@@ -186,22 +644,22 @@ private:
     
     void lmb(R src, R dst) override
     {
-        r[dst] = dram.read8(Address((r[src] + x[src]) & pm));
+        r[dst] = dram.get8((r[src] + x[src]) & pm);
     }
     
     void lmd(R src, R dst) override
     {
-        r[dst] = dram.read64(Address((r[src] + x[src]) & pm));
+        r[dst] = dram.get64((r[src] + x[src]) & pm);
     }
     
     void lmh(R src, R dst) override
     {
-        r[dst] = dram.read16(Address((r[src] + x[src]) & pm));
+        r[dst] = dram.get16((r[src] + x[src]) & pm);
     }
     
     void lmw(R src, R dst) override
     {
-        r[dst] = dram.read32(Address((r[src] + x[src]) & pm));
+        r[dst] = dram.get32((r[src] + x[src]) & pm);
     }
     
     void lrr(R src, R dst) override
@@ -241,7 +699,7 @@ private:
     
     void popb(R dst) override
     {
-        r[dst] = dram.read8(Address(s[0] & pm));
+        r[dst] = dram.get8(s[0] & pm);
         ++s[0];
     }
     
@@ -252,7 +710,7 @@ private:
     
     void popd(R dst) override
     {
-        r[dst] = dram.read64(Address(s[0] & pm));
+        r[dst] = dram.get64(s[0] & pm);
         s[0] += 8;
     }
     
@@ -263,7 +721,7 @@ private:
     
     void poph(R dst) override
     {
-        r[dst] = dram.read16(Address(s[0] & pm));
+        r[dst] = dram.get16(s[0] & pm);
         s[0] += 2;
     }
     
@@ -281,19 +739,19 @@ private:
     {
         if (pm >> 32)
         {
-            s[dst] = dram.read64(Address(s[0] & pm));
+            s[dst] = dram.get64(s[0] & pm);
             if (dst != S(0))
                 s[0] += 8;
         }
         else if (pm >> 16)
         {
-            s[dst] = dram.read32(Address(s[0] & pm));
+            s[dst] = dram.get32(s[0] & pm);
             if (dst != S(0))
                 s[0] += 4;
         }
         else
         {
-            s[dst] = dram.read16(Address(s[0] & pm));
+            s[dst] = dram.get16(s[0] & pm);
             if (dst != S(0))
                 s[0] += 2;
         }
@@ -306,7 +764,7 @@ private:
     
     void popw(R dst) override
     {
-        r[dst] = dram.read32(Address(s[0] & pm));
+        r[dst] = dram.get32(s[0] & pm);
         s[0] += 4;
     }
     
@@ -318,7 +776,7 @@ private:
     void pushb(R src) override
     {
         --s[0];
-        dram.write8(Address(s[0] & pm), r[src] & 0xff);
+        dram.put8(s[0] & pm, r[src] & 0xff);
     }
     
     void pushd() override
@@ -329,7 +787,7 @@ private:
     void pushd(R src) override
     {
         s[0] -= 8;
-        dram.write64(Address(s[0] & pm), r[src]);
+        dram.put64(s[0] & pm, r[src]);
     }
     
     void pushh() override
@@ -340,7 +798,7 @@ private:
     void pushh(R src) override
     {
         s[0] -= 2;
-        dram.write16(Address(s[0] & pm), r[src] & 0xffff);
+        dram.put16(s[0] & pm, r[src] & 0xffff);
     }
     
     void pushs() override
@@ -359,17 +817,17 @@ private:
         if (pm >> 32)
         {
             tmp_sp -= 8;
-            dram.write64(Address(tmp_sp & pm), s[src]);
+            dram.put64(tmp_sp & pm, s[src]);
         }
         else if (pm >> 16)
         {
             tmp_sp -= 4;
-            dram.write32(Address(tmp_sp & pm), s[src] & 0xffff'ffff);
+            dram.put32(tmp_sp & pm, s[src] & 0xffff'ffff);
         }
         else
         {
             tmp_sp -= 2;
-            dram.write16(Address(tmp_sp & pm), s[src] & 0xffff);
+            dram.put16(tmp_sp & pm, s[src] & 0xffff);
         }
         s[0] = tmp_sp;
     }
@@ -382,24 +840,24 @@ private:
     void pushw(R src) override
     {
         s[0] -= 4;
-        dram.write32(Address(s[0] & pm), r[src] & 0xffff'ffff);
+        dram.put32(s[0] & pm, r[src] & 0xffff'ffff);
     }
     
     void ret() override
     {
         if (pm >> 32)
         {
-            pc = dram.read64(Address(s[0] & pm));
+            pc = dram.get64(s[0] & pm);
             s[0] += 8;
         }
         else if (pm >> 16)
         {
-            pc = dram.read32(Address(s[0] & pm));
+            pc = dram.get32(s[0] & pm);
             s[0] += 4;
         }
         else
         {
-            pc = dram.read16(Address(s[0] & pm));
+            pc = dram.get16(s[0] & pm);
             s[0] += 2;
         }
     }
@@ -425,42 +883,43 @@ private:
     
     void stmb(R src, R dst) override
     {
-        dram.write8(Address(r[dst] + x[dst] & pm), r[src] & 0xff);
+        dram.put8(r[dst] + x[dst] & pm, r[src] & 0xff);
     }
     
     void stmd(R src, R dst) override
     {
-        dram.write64(Address(r[dst] + x[dst] & pm), r[src]);
+        dram.put64(r[dst] + x[dst] & pm, r[src]);
     }
     
     void stmh(R src, R dst) override
     {
-        dram.write16(Address(r[dst] + x[dst] & pm), r[src] & 0xffff);
+        dram.put16(r[dst] + x[dst] & pm, r[src] & 0xffff);
     }
     
     void stmw(R src, R dst) override
     {
-        dram.write32(Address(r[dst] + x[dst] & pm), r[src] & 0xffff'ffff);
+        dram.put32(r[dst] + x[dst] & pm, r[src] & 0xffff'ffff);
     }
     
     void strr(R src, R dst) override
     {
-        dram.write8(Address(r[dst] + x[dst] & pm),
-                                    dram.read8(Address(r[src] + x[src] & pm)));
+        dram.put8(r[dst] + x[dst] & pm,
+                                    dram.get8(r[src] + x[src] & pm));
     }
     
     void strs(R src, S dst) override
     {
-        dram.write8(Address(s[dst] + x[dst] & pm),
-                                    dram.read8(Address(r[src] + x[src] & pm)));
+        dram.put8(s[dst] + x[dst] & pm,
+                                    dram.get8(r[src] + x[src] & pm));
     }
     
     void stsr(S src, R dst) override
     {
-        dram.write8(Address(r[dst] + x[dst] & pm),
-                                    dram.read8(Address(s[src] + x[src] & pm)));
+        dram.put8(r[dst] + x[dst] & pm,
+                                    dram.get8(s[src] + x[src] & pm));
     }
     
+    // Only for callers of Processor, like unimplemented
     void sys(R src, R dst) override
     {
         throw System_trap(src, dst);
@@ -471,14 +930,19 @@ private:
         r[dst] ^= r[src];
     }
     
-    Simple_memory cram;
-    Memory_be dram;
+    Paged_memory cram;
+    Guarded_memory_be dram;
     std::uint_least64_t pm;
     std::uint_least64_t pc = 0;
     std::uint_least64_t r[2] = {0, 0};
     std::uint_least64_t s[2] = {0, 0};
     std::uint_least64_t x[2] = {0, 0};
-    bool running = false;
+    std::uint_least64_t executed = 0;
+    Zero_pages<Decoded> decoded;
+    bool any_decoded = false;
+    std::unique_ptr<Zero_pages<std::uint_least64_t>> runs;
+    std::unique_ptr<Zero_pages<std::uint_least64_t>> calls;
+    std::set<std::uint_least64_t> run_pages;
 }; // class Cpu
 
 } // namespace vs
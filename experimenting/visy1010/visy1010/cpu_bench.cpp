@@ -0,0 +1,249 @@
+// cpu_bench.cpp
+// Benchmark suite of the virtual CPU
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "cpu_bench.hpp"
+#include "assembler.hpp"
+#include "cpu.hpp"
+
+#include "using_cstdint.hpp"
+#include "using_iostream.hpp"
+#include "using_string.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace vs
+{
+
+namespace
+{
+
+constexpr unsigned bits = 16;
+constexpr uint_least64_t instructions = 20'000'000;
+constexpr unsigned runs = 3;            // The best one counts
+constexpr unsigned unrolled = 64;
+constexpr uint_least16_t source = 0x4000;
+constexpr uint_least16_t target = 0x8000;
+constexpr uint_least64_t stack = 0xf000;
+
+// Each workload is a body that the program repeats forever, calling the
+// system after each pass, so that the host can stop it. Bodies are unrolled
+// so that the loop around them is a small part of what runs.
+struct Workload
+{
+    const char* name;
+    void (*body)(Assembler& as);
+};
+
+void alu(Assembler& as)
+{
+    as.lihz(0x1234, R(0));
+    as.lihz(3, R(1));
+    for (unsigned i = 0; i < unrolled; ++i)
+    {
+        as.shl(R(1), R(0));
+        as.orb(R(1), R(0));
+        as.xorb(R(0), R(1));
+        as.andb(R(0), R(1));
+        as.notb(R(0), R(0));
+        as.shr(R(1), R(0));
+        as.least(R(0), R(1));
+        as.lrr(R(1), R(0));
+    }
+}
+
+void constants(Assembler& as)
+{
+    for (unsigned i = 0; i < unrolled; ++i)
+    {
+        as.lihz(static_cast<uint_least16_t>(0x1000 + i), R(0));
+        as.liw(0x1234'5678 + i, R(1));
+        as.lid(0x0123'4567'89ab'cdefull + i, R(0));
+    }
+}
+
+// Bytes from source to target, as code that copies a block would do it: the
+// offset in both registers, and the bases in the index registers
+void copy(Assembler& as)
+{
+    for (unsigned i = 0; i < unrolled * 4; ++i)
+    {
+        as.lihz(static_cast<uint_least16_t>(i), R(0));
+        as.lrr(R(0), R(1));
+        as.strr(R(0), R(1));
+    }
+}
+
+// Recursion 64 levels deep and back, shifting a bit out of r0 at each level
+void calls(Assembler& as)
+{
+    as.lid(~uint_least64_t {0}, R(0));
+    as.call("recursive", R(1));
+}
+
+void recursive(Assembler& as)
+{
+    as.label("recursive");
+    as.lihz(1, R(1));
+    as.shr(R(1), R(0));
+    as.jmpz(R(0), "bottom", R(1));
+    as.call("recursive", R(1));
+    as.label("bottom");
+    as.ret();
+}
+
+void stack_pairs(Assembler& as)
+{
+    for (unsigned i = 0; i < unrolled; ++i)
+    {
+        as.pushb(R(0));
+        as.pushb(R(1));
+        as.popb(R(1));
+        as.popb(R(0));
+        as.pushh(R(0));
+        as.pushh(R(1));
+        as.poph(R(1));
+        as.poph(R(0));
+        as.pushw(R(0));
+        as.pushw(R(1));
+        as.popw(R(1));
+        as.popw(R(0));
+        as.pushd(R(0));
+        as.pushd(R(1));
+        as.popd(R(1));
+        as.popd(R(0));
+    }
+}
+
+// A value loaded from source and stored at target, with the offsets in
+// r0 and r1. Nothing writes to source, so the value loaded is 0 and r0
+// keeps the offset for the next load.
+template<void (Assembler::*load)(R, R), void (Assembler::*store)(R, R)>
+void memory(Assembler& as)
+{
+    as.lihz(0, R(0));
+    as.lihz(0, R(1));
+    for (unsigned i = 0; i < unrolled * 4; ++i)
+    {
+        (as.*load)(R(0), R(0));
+        (as.*store)(R(0), R(1));
+    }
+}
+
+const Workload workloads[] =
+{
+    {"alu", alu},
+    {"constants", constants},
+    {"copy (strr)", copy},
+    {"calls", calls},
+    {"stack", stack_pairs},
+    {"bytes", memory<&Assembler::lmb, &Assembler::stmb>},
+    {"halves", memory<&Assembler::lmh, &Assembler::stmh>},
+    {"words", memory<&Assembler::lmw, &Assembler::stmw>},
+    {"doubles", memory<&Assembler::lmd, &Assembler::stmd>}
+};
+
+// Source and target in the index registers, then the body in a loop
+void assemble(Cpu& cpu, const Workload& workload)
+{
+    Assembler as {cpu.code_ram(), cpu.data_ram()};
+    as.lihz(source, R(0));
+    as.lrx(R(0), X(0));
+    as.lihz(target, R(0));
+    as.lrx(R(0), X(1));
+    as.label("top");
+    workload.body(as);
+    as.sys(R(1), R(0));
+    as.jmp("top", R(1));
+    if (workload.body == calls)
+        recursive(as);
+    as.end();
+}
+
+struct Timing
+{
+    uint_least64_t instructions;
+    double seconds;
+    bool ok;
+};
+
+Timing run(const Workload& workload)
+{
+    using clock = std::chrono::steady_clock;
+    Timing best {0, 0, true};
+    for (unsigned i = 0; i < runs; ++i)
+    {
+        Cpu cpu {bits};
+        assemble(cpu, workload);
+        cpu.reset();
+        cpu.s0() = stack;
+        auto start = clock::now();
+        while (cpu.instructions() < instructions)
+        {
+            // Every pass leaves the stack as it found it
+            if (cpu.loop().cause != Trap::Cause::system || cpu.s0() != stack)
+                return {0, 0, false};
+        }
+        std::chrono::duration<double> t = clock::now() - start;
+        if (i == 0 || t.count() < best.seconds)
+            best = {cpu.instructions(), t.count(), true};
+    }
+    return best;
+}
+
+} // namespace
+
+int bench_cpu(std::ostream& out)
+{
+    out << "workload       instructions      MIPS  ns/instruction\n";
+    uint_least64_t total = 0;
+    double seconds = 0;
+    for (const auto& workload: workloads)
+    {
+        Timing timing = run(workload);
+        if (!timing.ok)
+        {
+            out << workload.name << ": unexpected trap or stack\n";
+            return 1;
+        }
+        total += timing.instructions;
+        seconds += timing.seconds;
+        out << std::left << setw(12) << workload.name << std::right <<
+            setw(15) << timing.instructions << std::fixed <<
+            std::setprecision(1) << setw(10) <<
+            timing.instructions / timing.seconds / 1e6 <<
+            std::setprecision(2) << setw(16) <<
+            timing.seconds * 1e9 / timing.instructions << '\n';
+    }
+    out << std::left << setw(12) << "total" << std::right << setw(15) <<
+        total << std::setprecision(1) << setw(10) << total / seconds / 1e6 <<
+        std::setprecision(2) << setw(16) << seconds * 1e9 / total << '\n';
+    return 0;
+}
+
+}
@@ -0,0 +1,45 @@
+// cpu_bench.hpp
+// Benchmark suite of the virtual CPU
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef fauvisy_cpu_bench_hpp
+#define fauvisy_cpu_bench_hpp
+
+#include <ostream>
+
+namespace vs
+{
+
+// Runs a fixed set of guest workloads, assembled here, each of them for the
+// same number of instructions, and prints the speed of each one and overall
+// in a table that keeps its layout from one version to the next. Returns the
+// exit status.
+int bench_cpu(std::ostream& out);
+
+}
+
+#endif /* fauvisy_cpu_bench_hpp */
@@ -35,12 +35,22 @@ SOFTWARE.
 #include "using_iostream.hpp"
 #include "using_string.hpp"
 #include "using_cstdint.hpp"
+#include "using_algorithm.hpp"
+#include "using_containers.hpp"
 
 namespace vs
 {
 
-Environment::Environment(unsigned bits) : cpu(bits)
+Environment::Environment(unsigned bits, ostream& console, ostream& errors,
+                                                            istream& input) :
+cpu(bits),
+address_bytes {bits <= 16 ? 2U : bits <= 32 ? 4U : 8U},
+console {console},
+errors {errors},
+input {input},
+files(3, nullptr)
 {
+    console_buffer.reserve(console_capacity);
     /*
     Assembler as {cpu.code_ram(), cpu.data_ram()};
     as.lihz(0, R(0));
@@ -62,11 +72,22 @@ Environment::Environment(unsigned bits) : cpu(bits)
     abort();*/
 }
 
+Environment::~Environment()
+{
+    flush_console();
+    for (auto f: files)
+    {
+        if (f)
+            std::fclose(f);
+    }
+}
+
 void Environment::load_exec(int argc, char **argv)
 {
     if (argc > 0)
     {
         cout << "argv[0]: " << argv[0] << "\n";
+        cout << "filename: " << argv[0] << "\n";
         Program prog {argv[0]};
         cpu.code_ram().load(prog.code(), 0);
         cpu.sdata_ram().load(prog.data(), 0);
@@ -81,26 +102,44 @@ void Environment::start(int argc, char** argv)
 {
     cout << "argc: " << argc << '\n';
     load_exec(argc, argv);
+    execute();
+}
+
+void Environment::run(const vector<unsigned char>& code,
+                                            const vector<unsigned char>& data)
+{
+    cpu.code_ram().load(code, 0);
+    cpu.sdata_ram().load(data, 0);
+    execute();
+}
+
+void Environment::profile(ostream& report, unsigned top, Symbol_names symbols)
+{
+    cpu.start_profile();
+    profile_report = &report;
+    profile_top = top;
+    profile_symbols = std::move(symbols);
+}
+
+void Environment::execute()
+{
     on = true;
+    has_left = false;
     cpu.reset();
     while (on)
     {
-        try
-        {
-            cpu.loop();
-        }
-        catch(Unimplemented_instruction_error e)
+        Trap trap = cpu.loop();
+        if (trap.cause == Trap::Cause::system)
+            system_trap(trap.s, trap.d);
+        else
         {
             on = false;
-            cout << setfill('0');
-            cout << "Unimplemented instruction 0x" << hex << setw(2) <<
-                        (unsigned)e.instruction << "\n";
-            cout << static_cast<string>(
-                                Disassembler {cpu.code_ram(), e.position, 1});
-        }
-        catch(System_trap e)
-        {
-           system_trap(e.s, e.d);
+            flush_console();
+            console << setfill('0');
+            console << "Unimplemented instruction 0x" << hex << setw(2) <<
+                        (unsigned)trap.instruction << "\n";
+            console << static_cast<string>(
+                            Disassembler {cpu.code_ram(), trap.position, 1});
         }
     }
 }
@@ -108,10 +147,10 @@ void Environment::start(int argc, char** argv)
 Environment::Trap_handler Environment::handlers[handler_max + 1] =
 {
     &Environment::leave,
-    &Environment::unsupported,
-    &Environment::unsupported,
-    &Environment::unsupported,
-    &Environment::unsupported,
+    &Environment::write,
+    &Environment::read,
+    &Environment::open,
+    &Environment::close,
     &Environment::unsupported,
     &Environment::unsupported,
     &Environment::unsupported,
@@ -148,10 +187,160 @@ void Environment::unsupported(uint_least64_t code, uint_least64_t param)
     throw Unsupported_trap(code, param);
 }
 
-void Environment::leave(uint_least64_t code, uint_least64_t param)
+// Reads count values of the size of an address, big endian, from addr in data
+// memory, returning false if they are not all inside
+bool Environment::parameters(uint_least64_t addr, uint_least64_t* values,
+                                                                unsigned count)
+{
+    auto p = cpu.sdata_ram().block(addr, count * address_bytes);
+    if (!p)
+        return false;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        uint_least64_t value = 0;
+        for (unsigned j = 0; j < address_bytes; ++j)
+            value = value << 8 | *p++;
+        values[i] = value;
+    }
+    return true;
+}
+
+void Environment::fail()
+{
+    cpu.r0() = ~uint_least64_t {0};
+}
+
+void Environment::flush_console()
 {
+    if (!console_buffer.empty())
+    {
+        console.write(console_buffer.data(), console_buffer.size());
+        console_buffer.clear();
+    }
+    console.flush();
+}
+
+// The open file for a descriptor above the console ones, or nullptr
+std::FILE* Environment::file(uint_least64_t descriptor)
+{
+    return descriptor < files.size() ? files[descriptor] : nullptr;
+}
+
+void Environment::leave(uint_least64_t, uint_least64_t param)
+{
+    flush_console();
     on = false;
+    has_left = true;
     leave_code = param & 0xffff;
+    if (profile_report)
+        print_profile(*profile_report, cpu, profile_top, profile_symbols);
+}
+
+// param points to {descriptor, buffer, size}. Returns the bytes written.
+void Environment::write(uint_least64_t, uint_least64_t param)
+{
+    uint_least64_t p[3];
+    if (!parameters(param, p, 3))
+        return fail();
+    auto buffer = cpu.sdata_ram().block(p[1], p[2]);
+    if (!buffer)
+        return fail();
+    auto text = reinterpret_cast<const char*>(buffer);
+    if (p[0] == 1)
+    {
+        if (p[2] > console_capacity - console_buffer.size())
+            flush_console();
+        if (p[2] >= console_capacity)
+            console.write(text, p[2]);
+        else
+            console_buffer.append(text, p[2]);
+        cpu.r0() = p[2];
+    }
+    else if (p[0] == 2)
+    {
+        flush_console();
+        errors.write(text, p[2]);
+        cpu.r0() = p[2];
+    }
+    else if (auto f = file(p[0]))
+        cpu.r0() = std::fwrite(buffer, 1, p[2], f);
+    else
+        fail();
+}
+
+// param points to {descriptor, buffer, size}. Returns the bytes read, which
+// are 0 at the end of the file. Reading the console stops after a new line.
+void Environment::read(uint_least64_t, uint_least64_t param)
+{
+    uint_least64_t p[3];
+    if (!parameters(param, p, 3))
+        return fail();
+    auto buffer = cpu.sdata_ram().block(p[1], p[2]);
+    if (!buffer)
+        return fail();
+    if (p[0] == 0)
+    {
+        flush_console();
+        uint_least64_t n = 0;
+        int c;
+        while (n < p[2] && (c = input.get()) != EOF)
+        {
+            buffer[n++] = static_cast<unsigned char>(c);
+            if (c == '\n')
+                break;
+        }
+        cpu.r0() = n;
+    }
+    else if (auto f = file(p[0]))
+    {
+        auto n = std::fread(buffer, 1, p[2], f);
+        if (n < p[2] && std::ferror(f))
+            fail();
+        else
+            cpu.r0() = n;
+    }
+    else
+        fail();
+}
+
+// param points to {path, mode}, where path ends with a zero byte and mode is
+// 0 for reading, 1 for writing and 2 for appending. Returns the descriptor.
+void Environment::open(uint_least64_t, uint_least64_t param)
+{
+    static const char* const modes[] = {"rb", "wb", "ab"};
+    uint_least64_t p[2];
+    if (!parameters(param, p, 2) || p[1] > 2)
+        return fail();
+    auto& dram = cpu.sdata_ram();
+    string path;
+    for (auto addr = p[0]; ; ++addr)
+    {
+        auto c = dram.block(addr, 1);
+        if (!c)
+            return fail();
+        if (*c == 0)
+            break;
+        path += static_cast<char>(*c);
+    }
+    auto f = std::fopen(path.c_str(), modes[p[1]]);
+    if (!f)
+        return fail();
+    auto slot = find(files.begin() + 3, files.end(), nullptr);
+    if (slot == files.end())
+        slot = files.insert(files.end(), f);
+    else
+        *slot = f;
+    cpu.r0() = slot - files.begin();
+}
+
+// param is the descriptor. Returns 0.
+void Environment::close(uint_least64_t, uint_least64_t param)
+{
+    auto f = file(param);
+    if (!f || param < 3)
+        return fail();
+    files[param] = nullptr;
+    cpu.r0() = std::fclose(f) == 0 ? 0 : ~uint_least64_t {0};
 }
 
 } // namespace vs
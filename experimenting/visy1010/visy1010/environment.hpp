@@ -31,6 +31,12 @@ SOFTWARE.
 #define fauvisy_environment_hpp
 
 #include "cpu.hpp"
+#include "profile.hpp"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
 
 namespace vs
 {
@@ -53,24 +59,76 @@ struct Unsupported_trap
     {}
 };
 
+// Runs programs, doing their system calls. See vs_os.md for the list.
 class Environment
 {
 public:
-    Environment(unsigned bits);
+    // Guest output to descriptor 1 goes to console, and so do messages about
+    // instructions that do not exist. Descriptor 2 writes to errors and
+    // descriptor 0 reads from input.
+    Environment(unsigned bits, std::ostream& console = std::cout,
+                                    std::ostream& errors = std::cerr,
+                                    std::istream& input = std::cin);
+    Environment(const Environment&) = delete;
+    Environment& operator=(const Environment&) = delete;
+    ~Environment();
+    
     void start(int argc, char** argv);
+    
+    // Runs a program whose sections are already in memory, as produced by a
+    // linker, instead of loading an executable file.
+    void run(const std::vector<unsigned char>& code,
+                                        const std::vector<unsigned char>& data);
+    
     std::uint_least16_t result()
     {
         return leave_code;
     }
     
+    // Whether the program ended by leaving, rather than by an instruction
+    // that does not exist
+    bool left() const
+    {
+        return has_left;
+    }
+    
+    // Run by the last program
+    std::uint_least64_t instructions() const
+    {
+        return cpu.instructions();
+    }
+    
+    // Profiles the programs run from now on, printing the top addresses and
+    // functions to report when they leave, named after symbols if given
+    void profile(std::ostream& report, unsigned top,
+                                                Symbol_names symbols = {});
+    
 private:
     Cpu cpu;
     bool on = false;
+    bool has_left = false;
     std::uint_least16_t leave_code = 0xffff;
+    unsigned address_bytes;
+    
+    // Output to descriptor 1 is kept here until leaving, reading from the
+    // console or filling it, so that printing does not cost a call each.
+    static constexpr std::size_t console_capacity = 1 << 16;
+    std::ostream& console;
+    std::string console_buffer;
+    std::ostream& errors;
+    std::istream& input;
+    
+    // Open files, by descriptor. The first three are the console.
+    std::vector<std::FILE*> files;
+    
+    std::ostream* profile_report = nullptr;
+    unsigned profile_top = 0;
+    Symbol_names profile_symbols;
     
     static int constexpr handler_max = 0xf;
     
     void load_exec(int argc, char** argv);
+    void execute();
     
     using Trap_handler = void (Environment::*)(std::uint_least64_t code,
                                                     std::uint_least64_t param);
@@ -79,7 +137,17 @@ private:
     void system_trap(R s, R d);
     void unsupported(std::uint_least64_t code, std::uint_least64_t param);
     
+    bool parameters(std::uint_least64_t addr, std::uint_least64_t* values,
+                                                                unsigned count);
+    void fail();
+    void flush_console();
+    std::FILE* file(std::uint_least64_t descriptor);
+    
     void leave(std::uint_least64_t code, std::uint_least64_t param);
+    void write(std::uint_least64_t code, std::uint_least64_t param);
+    void read(std::uint_least64_t code, std::uint_least64_t param);
+    void open(std::uint_least64_t code, std::uint_least64_t param);
+    void close(std::uint_least64_t code, std::uint_least64_t param);
 };
 
 } // namespace vs
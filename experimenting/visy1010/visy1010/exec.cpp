@@ -34,6 +34,8 @@ SOFTWARE.
 #include "using_algorithm.hpp"
 #include "using_containers.hpp"
 
+#include <limits>
+
 namespace vs
 {
 static const unsigned char exe_uuid[16] =
@@ -96,7 +98,6 @@ Section_header load_section_header(istream& is)
 
 Program::Program(char* filename)
 {
-    cout << "filename: " << filename << "\n";
     ifstream ifs;
     ifs.exceptions(ios::failbit | ios::badbit | ios::eofbit);
     ifs.open(filename, ios::binary);
@@ -26,17 +26,56 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include "batch.hpp"
+#include "cpu_bench.hpp"
 #include "disassembler.hpp"
 #include "environment.hpp"
+#include "memory_bench.hpp"
+#include "snapshot_bench.hpp"
+#include "trap_bench.hpp"
 
 #include "using_cstdint.hpp"
 #include "using_iostream.hpp"
 #include "using_string.hpp"
 #include "using_cstdlib.hpp"
+#include "using_containers.hpp"
+
+#include <chrono>
+#include <thread>
 
 
 using namespace vs;
 
+static constexpr unsigned memory_bits = 12;
+
+// Runs the executables of a manifest, or of the standard input if it is "-",
+// printing a table of their results
+static int batch(const string& manifest, const char* threads)
+{
+    vector<Batch_task> tasks;
+    if (manifest == "-")
+        tasks = read_manifest(cin);
+    else
+    {
+        ifstream ifs {manifest};
+        if (!ifs)
+        {
+            cout << "Cannot open " << manifest << '\n';
+            return EXIT_FAILURE;
+        }
+        tasks = read_manifest(ifs);
+    }
+    unsigned n = threads ? static_cast<unsigned>(std::strtoul(threads,
+                        nullptr, 10)) : std::thread::hardware_concurrency();
+    auto start = std::chrono::steady_clock::now();
+    auto results = run_batch(tasks, memory_bits, n);
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+    bool passed = print_results(cout, tasks, results);
+    cout << std::fixed << std::setprecision(3) << t.count() <<
+                                                    " s of wall time\n";
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char** argv)
 {
 /*    Simple_memory mem(256);
@@ -53,12 +92,37 @@ int main(int argc, char** argv)
                 e.position << '\n';
         cout << "Opcode: 0x" << setw(2) << (e.instruction >> 2) << dec << '\n';
     }*/
+    if (argc == 2 && string {argv[1]} == "--bench-cpu")
+        return bench_cpu(cout);
+    if (argc == 2 && string {argv[1]} == "--bench-memory")
+        return bench_memory(cout);
+    if (argc == 2 && string {argv[1]} == "--bench-traps")
+        return bench_traps(cout);
+    if (argc == 2 && string {argv[1]} == "--bench-snapshot")
+        return bench_snapshot(cout);
+    if ((argc == 3 || argc == 4) && string {argv[1]} == "--batch")
+        return batch(argv[2], argc == 4 ? argv[3] : nullptr);
+    unsigned profile_top = 0;
+    if (argc >= 4 && string {argv[1]} == "--profile")
+    {
+        profile_top = static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10));
+        argc -= 2;
+        argv += 2;
+    }
     if (argc < 2)
     {
-        cout << "Usage: visy1010 <executable> [<argument1> ... <argumentN>]\n";
+        cout << "Usage: visy1010 [--profile <top>] <executable> "
+                                            "[<argument1> ... <argumentN>]\n";
+        cout << "       visy1010 --bench-cpu\n";
+        cout << "       visy1010 --bench-memory\n";
+        cout << "       visy1010 --bench-traps\n";
+        cout << "       visy1010 --batch <manifest> [<threads>]\n";
+        cout << "       visy1010 --bench-snapshot\n";
         return EXIT_FAILURE;
     }
-    Environment env(12);
+    Environment env(memory_bits);
+    if (profile_top)
+        env.profile(cout, profile_top);
     env.start(argc - 1, &argv[1]);
     cout << "Result: 0x" << hex << setfill('0') << setw(4) << env.result();
     cout << '\n';
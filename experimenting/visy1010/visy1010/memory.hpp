@@ -35,6 +35,10 @@ SOFTWARE.
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <cstring>
+#include <stdexcept>
+
+#include "pages.hpp"
 
 namespace  vs
 {
@@ -91,6 +95,44 @@ protected:
     std::vector<byte_type> data;
 };
 
+// Memory of zeros until written, as large as the address space of the host
+// allows, of which the host only commits the pages written
+class Paged_memory final: public Memory
+{
+public:
+    Paged_memory(size_type size) : data(size)
+    {}
+    
+    byte_type& operator [](size_type n) override
+    {
+        return data[n];
+    }
+    
+    byte_type& at(size_type n) override
+    {
+        if (n >= data.size())
+            throw std::out_of_range("Address out of limits");
+        return data[n];
+    }
+    
+    void load(const std::vector<byte_type>& ext_data, size_type start) override
+    {
+        if (start > data.size())
+            throw std::out_of_range("Start address out of limits");
+        if (ext_data.size() > data.size() - start)
+            throw std::out_of_range("Source too big");
+        std::copy(ext_data.begin(), ext_data.end(), data.data() + start);
+    }
+    
+    Zero_pages<byte_type>& pages()
+    {
+        return data;
+    }
+    
+private:
+    Zero_pages<byte_type> data;
+};
+
 template <typename Address_type>
 class GenericAddress
 {
@@ -214,6 +256,209 @@ public:
     }
 };
 
+
+// Reverses the bytes of an unsigned integer, like std::byteswap of C++23
+template<typename T>
+T byteswap(T value)
+{
+    static_assert(sizeof value == 1 || sizeof value == 2 || sizeof value == 4
+                                                        || sizeof value == 8);
+#if defined(__GNUC__)
+    if constexpr (sizeof value == 2)
+        return __builtin_bswap16(value);
+    else if constexpr (sizeof value == 4)
+        return __builtin_bswap32(value);
+    else if constexpr (sizeof value == 8)
+        return __builtin_bswap64(value);
+    else
+        return value;
+#else
+    T swapped = 0;
+    for (unsigned i = 0; i < sizeof value; ++i)
+    {
+        swapped = static_cast<T>(swapped << 8 | (value & 0xff));
+        value = static_cast<T>(value >> 8);
+    }
+    return swapped;
+#endif
+}
+
+// Converts between big endian and the byte order of the host, which is
+// taken as little endian when the compiler does not tell.
+template<typename T>
+T big_endian(T value)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return value;
+#else
+    return byteswap(value);
+#endif
+}
+
+// Big-endian memory for the hot path of Cpu. Its get and put functions do not
+// check addresses, which must be lower than its size, as Cpu makes sure by
+// masking them: an access starting at the last byte still finds room in a
+// guard of 7 more bytes, so every access is a single copy plus a byte swap.
+// The functions of Bus64 check addresses and throw out_of_range, as
+// Memory_be does. Its bytes are Zero_pages, so only the pages written take
+// room in the host.
+class Guarded_memory_be final: public Memory, public Bus64
+{
+public:
+    static constexpr size_type guard = 7;
+    
+    Guarded_memory_be(size_type size) : size {size}, data(size + guard)
+    {}
+    
+    byte_type& operator [](size_type n) override
+    {
+        return data[n];
+    }
+    
+    byte_type& at(size_type n) override
+    {
+        check(n, 1);
+        return data[n];
+    }
+    
+    void load(const std::vector<byte_type>& ext_data, size_type start) override
+    {
+        if (start > size)
+            throw std::out_of_range("Start address out of limits");
+        if (ext_data.size() > size - start)
+            throw std::out_of_range("Source too big");
+        std::copy(ext_data.begin(), ext_data.end(), data.data() + start);
+    }
+    
+    // Its bytes, and then the guard
+    Zero_pages<byte_type>& pages()
+    {
+        return data;
+    }
+    
+    // The bytes from addr to addr + bytes, to copy whole buffers at once, or
+    // nullptr if they are not all inside
+    byte_type* block(size_type addr, size_type bytes)
+    {
+        if (addr > size || bytes > size - addr)
+            return nullptr;
+        return data.data() + addr;
+    }
+    
+    std::uint8_t get8(size_type addr)
+    {
+        return data[addr];
+    }
+    
+    std::uint16_t get16(size_type addr)
+    {
+        return get<std::uint16_t>(addr);
+    }
+    
+    std::uint32_t get32(size_type addr)
+    {
+        return get<std::uint32_t>(addr);
+    }
+    
+    std::uint64_t get64(size_type addr)
+    {
+        return get<std::uint64_t>(addr);
+    }
+    
+    void put8(size_type addr, std::uint8_t value)
+    {
+        data[addr] = value;
+    }
+    
+    void put16(size_type addr, std::uint16_t value)
+    {
+        put(addr, value);
+    }
+    
+    void put32(size_type addr, std::uint32_t value)
+    {
+        put(addr, value);
+    }
+    
+    void put64(size_type addr, std::uint64_t value)
+    {
+        put(addr, value);
+    }
+    
+    std::uint_least8_t read8(Address addr) override
+    {
+        check(addr, 1);
+        return get8(addr);
+    }
+    
+    void write8(Address addr, std::uint_least8_t value) override
+    {
+        check(addr, 1);
+        put8(addr, value & 0xff);
+    }
+    
+    std::uint_least16_t read16(Address addr) override
+    {
+        check(addr, 2);
+        return get16(addr);
+    }
+    
+    void write16(Address addr, std::uint_least16_t value) override
+    {
+        check(addr, 2);
+        put16(addr, value & 0xffff);
+    }
+    
+    std::uint_least32_t read32(Address addr) override
+    {
+        check(addr, 4);
+        return get32(addr);
+    }
+    
+    void write32(Address addr, std::uint_least32_t value) override
+    {
+        check(addr, 4);
+        put32(addr, value & 0xffff'ffff);
+    }
+    
+    std::uint_least64_t read64(Address addr) override
+    {
+        check(addr, 8);
+        return get64(addr);
+    }
+    
+    void write64(Address addr, std::uint_least64_t value) override
+    {
+        check(addr, 8);
+        put64(addr, value);
+    }
+    
+private:
+    size_type size;
+    Zero_pages<byte_type> data;
+    
+    void check(size_type addr, size_type bytes)
+    {
+        if (addr >= size || bytes > size - addr)
+            throw std::out_of_range("Address out of limits");
+    }
+    
+    template<typename T>
+    T get(size_type addr)
+    {
+        T value;
+        std::memcpy(&value, &data[addr], sizeof value);
+        return big_endian(value);
+    }
+    
+    template<typename T>
+    void put(size_type addr, T value)
+    {
+        value = big_endian(value);
+        std::memcpy(&data[addr], &value, sizeof value);
+    }
+};
+
 }
 
 #endif /* fauvisy_memory_hpp */
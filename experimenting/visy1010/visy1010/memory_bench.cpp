@@ -0,0 +1,177 @@
+// memory_bench.cpp
+// Micro-benchmark of data memory
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "memory_bench.hpp"
+#include "memory.hpp"
+
+#include "using_cstdint.hpp"
+#include "using_iostream.hpp"
+
+#include <chrono>
+
+namespace vs
+{
+
+// Room for any access at any address of 16 bits, which Memory_be needs
+static constexpr std::size_t address_mask = 0xffff;
+static constexpr std::size_t memory_size = address_mask + 8;
+static constexpr unsigned long accesses = 1ul << 24;
+
+// Scattered addresses, masked as Cpu does
+class Address_sequence
+{
+public:
+    std::size_t next()
+    {
+        state = state * 1664525 + 1013904223;
+        return state >> 8 & address_mask;
+    }
+    
+private:
+    uint_least32_t state = 1;
+};
+
+template<unsigned bytes>
+static uint_least64_t read(Memory_be& memory, std::size_t addr)
+{
+    if constexpr (bytes == 1)
+        return memory.read8(Address(addr));
+    else if constexpr (bytes == 2)
+        return memory.read16(Address(addr));
+    else if constexpr (bytes == 4)
+        return memory.read32(Address(addr));
+    else
+        return memory.read64(Address(addr));
+}
+
+template<unsigned bytes>
+static uint_least64_t read(Guarded_memory_be& memory, std::size_t addr)
+{
+    if constexpr (bytes == 1)
+        return memory.get8(addr);
+    else if constexpr (bytes == 2)
+        return memory.get16(addr);
+    else if constexpr (bytes == 4)
+        return memory.get32(addr);
+    else
+        return memory.get64(addr);
+}
+
+template<unsigned bytes>
+static void write(Memory_be& memory, std::size_t addr, uint_least64_t value)
+{
+    if constexpr (bytes == 1)
+        memory.write8(Address(addr), value & 0xff);
+    else if constexpr (bytes == 2)
+        memory.write16(Address(addr), value & 0xffff);
+    else if constexpr (bytes == 4)
+        memory.write32(Address(addr), value & 0xffff'ffff);
+    else
+        memory.write64(Address(addr), value);
+}
+
+template<unsigned bytes>
+static void write(Guarded_memory_be& memory, std::size_t addr,
+                                                        uint_least64_t value)
+{
+    if constexpr (bytes == 1)
+        memory.put8(addr, value & 0xff);
+    else if constexpr (bytes == 2)
+        memory.put16(addr, value & 0xffff);
+    else if constexpr (bytes == 4)
+        memory.put32(addr, value & 0xffff'ffff);
+    else
+        memory.put64(addr, value);
+}
+
+struct Access_times
+{
+    double write_ns;
+    double read_ns;
+    uint_least64_t sum;     // Of every value read
+};
+
+template<unsigned bytes, typename M>
+static Access_times time_accesses(M& memory)
+{
+    using clock = std::chrono::steady_clock;
+    Access_times times;
+    Address_sequence addresses;
+    auto start = clock::now();
+    for (unsigned long i = 0; i < accesses; ++i)
+        write<bytes>(memory, addresses.next(), i * 0x0123'4567'89ab'cdefull);
+    std::chrono::duration<double, std::nano> t = clock::now() - start;
+    times.write_ns = t.count() / accesses;
+    times.sum = 0;
+    start = clock::now();
+    for (unsigned long i = 0; i < accesses; ++i)
+        times.sum += read<bytes>(memory, addresses.next());
+    t = clock::now() - start;
+    times.read_ns = t.count() / accesses;
+    return times;
+}
+
+template<unsigned bytes>
+static bool bench_width(std::ostream& out)
+{
+    Memory_be checked {memory_size};
+    Guarded_memory_be guarded {memory_size};
+    Access_times before = time_accesses<bytes>(checked);
+    Access_times after = time_accesses<bytes>(guarded);
+    for (std::size_t i = 0; i < memory_size; ++i)
+    {
+        if (checked[i] != guarded[i])
+        {
+            out << "Different contents at 0x" << hex << i << dec << "\n";
+            return false;
+        }
+    }
+    if (before.sum != after.sum)
+    {
+        out << "Different values read with " << bytes * 8 << " bits\n";
+        return false;
+    }
+    out << setw(5) << bytes * 8 << "  write" << std::fixed <<
+        std::setprecision(2) << setw(12) << before.write_ns << setw(11) <<
+        after.write_ns << setw(10) << before.write_ns / after.write_ns << "\n";
+    out << setw(5) << bytes * 8 << "   read" << setw(12) << before.read_ns <<
+        setw(11) << after.read_ns << setw(10) <<
+        before.read_ns / after.read_ns << "\n";
+    return true;
+}
+
+int bench_memory(std::ostream& out)
+{
+    out << " bits access   Memory_be    Guarded   speedup  (ns per access)\n";
+    bool same = bench_width<1>(out) && bench_width<2>(out) &&
+                                    bench_width<4>(out) && bench_width<8>(out);
+    return same ? 0 : 1;
+}
+
+}
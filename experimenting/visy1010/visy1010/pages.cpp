@@ -0,0 +1,116 @@
+// pages.cpp
+// Zero-filled memory committed page by page
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "pages.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#else
+#include <cstdlib>
+#include <cstring>
+#endif
+
+namespace vs
+{
+
+// Anonymous private mappings are zeros that the host commits page by page
+// on the first write. Without reserving swap for them, a mapping as large as
+// the whole memory of the virtual system is just address space.
+#if defined(__unix__) || defined(__APPLE__)
+
+#if defined(MAP_NORESERVE)
+#define VS_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE)
+#else
+#define VS_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS)
+#endif
+
+void* map_zero_pages(std::size_t bytes)
+{
+    void* pages = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, VS_MAP_FLAGS,
+                                                                        -1, 0);
+    if (pages == MAP_FAILED)
+        throw std::bad_alloc();
+    return pages;
+}
+
+void unmap_pages(void* pages, std::size_t bytes)
+{
+    munmap(pages, bytes);
+}
+
+// Mapping again in the same place drops the pages written, while
+// madvise(MADV_DONTNEED) only zeros them on some hosts
+void zero_pages(void* pages, std::size_t bytes)
+{
+    if (mmap(pages, bytes, PROT_READ | PROT_WRITE, VS_MAP_FLAGS | MAP_FIXED,
+                                                        -1, 0) == MAP_FAILED)
+        throw std::bad_alloc();
+}
+
+void map_file_pages(void* pages, std::size_t bytes, std::FILE* file,
+                                                    std::uint_least64_t offset)
+{
+    if (mmap(pages, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+        fileno(file), static_cast<off_t>(offset)) == MAP_FAILED)
+        throw std::bad_alloc();
+}
+
+#else
+
+// Elsewhere, calloc gets large blocks of zeros from the host, usually without
+// touching them
+void* map_zero_pages(std::size_t bytes)
+{
+    void* pages = std::calloc(bytes, 1);
+    if (!pages)
+        throw std::bad_alloc();
+    return pages;
+}
+
+void unmap_pages(void* pages, std::size_t bytes)
+{
+    std::free(pages);
+}
+
+void zero_pages(void* pages, std::size_t bytes)
+{
+    std::memset(pages, 0, bytes);
+}
+
+// Without mappings of files, they are read whole
+void map_file_pages(void* pages, std::size_t bytes, std::FILE* file,
+                                                    std::uint_least64_t offset)
+{
+    if (std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0 ||
+                                    std::fread(pages, 1, bytes, file) != bytes)
+        throw std::bad_alloc();
+}
+
+#endif
+
+} // namespace vs
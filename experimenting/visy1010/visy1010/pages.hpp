@@ -0,0 +1,128 @@
+// pages.hpp
+// Zero-filled memory committed page by page
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef fauvisy_pages_hpp
+#define fauvisy_pages_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+namespace vs
+{
+
+// Maps bytes of zeros, which the host only commits as they are written.
+// Throws std::bad_alloc if the host has no room for them in its address space.
+void* map_zero_pages(std::size_t bytes);
+
+void unmap_pages(void* pages, std::size_t bytes);
+
+// Back to zeros, returning the committed pages to the host
+void zero_pages(void* pages, std::size_t bytes);
+
+// Maps bytes of file from offset, a multiple of 64 KiB, in place of pages.
+// The mapping is private: the host reads pages of the file as they are used
+// and copies them when they are first written, which never reaches the file.
+// Throws std::bad_alloc if the host cannot map them.
+void map_file_pages(void* pages, std::size_t bytes, std::FILE* file,
+                                                    std::uint_least64_t offset);
+
+// An array of values of T starting with all of their bits zero. Creating it
+// takes the same time for any size, and the host only commits the pages
+// that are written, so memories of 2^32 bytes cost what programs use of them.
+template<typename T>
+class Zero_pages
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                                            "Zero bits must be a valid T");
+public:
+    explicit Zero_pages(std::size_t count) :
+    count {count},
+    bytes {bytes_for(count)},
+    values {static_cast<T*>(map_zero_pages(bytes))}
+    {}
+    
+    Zero_pages(const Zero_pages&) = delete;
+    Zero_pages& operator=(const Zero_pages&) = delete;
+    
+    ~Zero_pages()
+    {
+        unmap_pages(values, bytes);
+    }
+    
+    T& operator [](std::size_t n)
+    {
+        return values[n];
+    }
+    
+    const T& operator [](std::size_t n) const
+    {
+        return values[n];
+    }
+    
+    T* data()
+    {
+        return values;
+    }
+    
+    std::size_t size() const
+    {
+        return count;
+    }
+    
+    void clear()
+    {
+        zero_pages(values, bytes);
+    }
+    
+    // The values are the bytes of file from offset, as map_file_pages says
+    void map_file(std::FILE* file, std::uint_least64_t offset)
+    {
+        map_file_pages(values, bytes, file, offset);
+    }
+    
+private:
+    std::size_t count;
+    std::size_t bytes;
+    T* values;
+    
+    static std::size_t bytes_for(std::size_t count)
+    {
+        if (count == 0 ||
+                    count > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            throw std::bad_alloc();
+        return count * sizeof(T);
+    }
+};
+
+} // namespace vs
+
+#endif /* fauvisy_pages_hpp */
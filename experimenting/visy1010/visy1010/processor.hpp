@@ -58,6 +58,24 @@ struct System_trap
     {}
 };
 
+// Why Cpu::loop returned, leaving the program counter past the instruction
+// that caused it: a sys instruction, whose registers are s and d, or one that
+// does not exist, whose position and value are given.
+struct Trap
+{
+    enum class Cause
+    {
+        system,
+        unimplemented
+    };
+    
+    Cause cause;
+    R s;
+    R d;
+    std::size_t position;
+    std::uint_least8_t instruction;
+};
+
 class Processor
 {
 public:
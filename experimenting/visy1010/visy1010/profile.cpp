@@ -0,0 +1,185 @@
+// profile.cpp
+// Hot spots of programs run by the virtual CPU
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "profile.hpp"
+#include "disassembler.hpp"
+
+#include "using_algorithm.hpp"
+#include "using_containers.hpp"
+#include "using_cstdint.hpp"
+#include "using_iostream.hpp"
+#include "using_string.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+namespace vs
+{
+
+namespace
+{
+
+struct Function
+{
+    uint_least64_t instructions = 0;
+    uint_least64_t calls = 0;
+};
+
+unsigned address_bits(uint_least64_t pm)
+{
+    unsigned bits = 0;
+    for (; pm; pm >>= 1)
+        ++bits;
+    return bits;
+}
+
+string hex_address(uint_least64_t addr, unsigned bits)
+{
+    std::ostringstream text;
+    text << "0x" << hex << setfill('0') << setw((bits + 3) / 4) << addr;
+    return text.str();
+}
+
+// The name of the function starting at start
+string function_name(uint_least64_t start, const Symbol_names& symbols,
+                                                                unsigned bits)
+{
+    auto symbol = symbols.find(start);
+    return symbol == symbols.end() ? hex_address(start, bits) : symbol->second;
+}
+
+// The symbol addr is in and how far, or nothing if there are no symbols
+string location(uint_least64_t addr, const Symbol_names& symbols)
+{
+    auto symbol = symbols.upper_bound(addr);
+    if (symbol == symbols.begin())
+        return "";
+    --symbol;
+    std::ostringstream text;
+    text << symbol->second;
+    if (addr != symbol->first)
+        text << "+0x" << hex << addr - symbol->first;
+    return text.str();
+}
+
+// Sorts the n biggest first and drops the rest
+template<typename T, typename Less>
+void keep_top(vector<T>& items, unsigned n, Less less)
+{
+    auto middle = items.begin() + std::min<std::size_t>(n, items.size());
+    std::partial_sort(items.begin(), middle, items.end(), less);
+    items.erase(middle, items.end());
+}
+
+double percentage(uint_least64_t part, uint_least64_t total)
+{
+    return total ? 100.0 * part / total : 0;
+}
+
+} // namespace
+
+void print_profile(ostream& out, Cpu& cpu, unsigned top,
+                                                const Symbol_names& symbols)
+{
+    uint_least64_t pm = cpu.pointer_mask();
+    unsigned bits = address_bits(pm);
+    
+    // Only pages where something ran, so that the report costs what the
+    // program used rather than what it could have used.
+    vector<std::pair<uint_least64_t, uint_least64_t>> hot;  // Address, runs
+    Symbol_names starts = symbols;
+    if (symbols.empty())
+        starts.emplace(0, hex_address(0, bits));
+    uint_least64_t total = 0;
+    for (uint_least64_t first: cpu.pages_run())
+    {
+        uint_least64_t last = first + std::min(Cpu::page_size - 1, pm);
+        for (uint_least64_t addr = first; ; ++addr)
+        {
+            if (uint_least64_t runs = cpu.runs_at(addr))
+            {
+                hot.emplace_back(addr, runs);
+                total += runs;
+            }
+            if (symbols.empty() && cpu.calls_to(addr))
+                starts.emplace(addr, hex_address(addr, bits));
+            if (addr == last)
+                break;
+        }
+    }
+    
+    std::map<uint_least64_t, Function> functions;
+    for (auto [addr, runs]: hot)
+    {
+        auto start = starts.upper_bound(addr);
+        if (start != starts.begin())
+            functions[(--start)->first].instructions += runs;
+    }
+    for (auto& [start, function]: functions)
+        function.calls = cpu.calls_to(start);
+    
+    auto more_runs = [](const auto& a, const auto& b)
+    {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    };
+    keep_top(hot, top, more_runs);
+    vector<std::pair<uint_least64_t, uint_least64_t>> by_instructions;
+    for (auto& [start, function]: functions)
+        by_instructions.emplace_back(start, function.instructions);
+    keep_top(by_instructions, top, more_runs);
+    
+    out << "Profile of " << total << " instructions\n";
+    out << "Hottest addresses:\n";
+    out << "          runs       %  instruction\n";
+    for (auto [addr, runs]: hot)
+    {
+        string line = Disassembler {cpu.code_ram(), addr, 1,
+                                                static_cast<int>(bits)};
+        line.pop_back();
+        out << setw(14) << runs << std::fixed << std::setprecision(1) <<
+                    setw(7) << percentage(runs, total) << "%  " << line;
+        string where = location(addr, symbols);
+        if (!where.empty())
+        {
+            out << string(std::max<std::size_t>(1, 28 - line.size()), ' ') <<
+                                                                        where;
+        }
+        out << '\n';
+    }
+    out << "Hottest functions:\n";
+    out << "  instructions       %         calls  function\n";
+    for (auto [start, instructions]: by_instructions)
+    {
+        out << setw(14) << instructions << std::fixed << std::setprecision(1) <<
+            setw(7) << percentage(instructions, total) << "%  " << setw(12) <<
+            functions[start].calls << "  " <<
+                                    function_name(start, starts, bits) << '\n';
+    }
+}
+
+} // namespace vs
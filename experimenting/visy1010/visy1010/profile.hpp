@@ -0,0 +1,54 @@
+// profile.hpp
+// Hot spots of programs run by the virtual CPU
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef fauvisy_profile_hpp
+#define fauvisy_profile_hpp
+
+#include "cpu.hpp"
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace vs
+{
+
+// Names of symbols of code, by address
+using Symbol_names = std::map<std::uint_least64_t, std::string>;
+
+// Prints what cpu counted since Cpu::start_profile: the top addresses by the
+// times their instructions ran, disassembled, and the top functions by the
+// instructions run inside them, with the times they were called. Functions
+// start at symbols if there are any, or else at the addresses called.
+void print_profile(std::ostream& out, Cpu& cpu, unsigned top,
+                                            const Symbol_names& symbols = {});
+
+} // namespace vs
+
+#endif /* fauvisy_profile_hpp */
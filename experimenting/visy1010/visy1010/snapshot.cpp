@@ -0,0 +1,164 @@
+// snapshot.cpp
+// Saved state of the virtual CPU
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "snapshot.hpp"
+
+#include "using_cstdint.hpp"
+#include "using_string.hpp"
+
+#include <algorithm>
+
+// The file starts with a header: a magic number and the values of the
+// registers, 8 bytes each, big endian, in the order of saved. Code memory
+// follows at 64 KiB, and then data memory with its guard, each at a multiple
+// of 64 KiB, so that they can be mapped.
+
+namespace vs
+{
+
+static const char magic[8] = {'V', 'S', 'S', 'N', 'A', 'P', '0', '1'};
+static constexpr uint_least64_t alignment = 0x10000;
+
+static uint_least64_t aligned(uint_least64_t bytes)
+{
+    return (bytes + alignment - 1) & ~(alignment - 1);
+}
+
+static uint_least64_t code_offset()
+{
+    return alignment;
+}
+
+static uint_least64_t data_offset(uint_least64_t pm)
+{
+    return code_offset() + aligned(pm + 1);
+}
+
+static void seek(std::FILE* file, uint_least64_t offset, const string& path)
+{
+    if (std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0)
+        throw Snapshot_error("Cannot seek in " + path);
+}
+
+// Writes bytes from pages at offset, skipping blocks of zeros, which stay
+// holes of the file. The last byte is always written, so that the file gets
+// to the end of the pages.
+static void write_pages(std::FILE* file, const unsigned char* pages,
+                uint_least64_t bytes, uint_least64_t offset, const string& path)
+{
+    for (uint_least64_t pos = 0; pos < bytes; pos += alignment)
+    {
+        auto n = static_cast<std::size_t>(std::min(alignment, bytes - pos));
+        const unsigned char* block = pages + pos;
+        bool last = pos + n == bytes;
+        if (!last && std::all_of(block, block + n,
+                                            [](unsigned char c){return !c;}))
+            continue;
+        seek(file, offset + pos, path);
+        if (std::fwrite(block, 1, n, file) != n)
+            throw Snapshot_error("Cannot write " + path);
+    }
+}
+
+void Snapshot::save(Cpu& cpu, const string& path)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        throw Snapshot_error("Cannot create " + path);
+    try
+    {
+        const uint_least64_t state[values] = {cpu.pm, cpu.pc,
+            cpu.r[0], cpu.r[1], cpu.s[0], cpu.s[1], cpu.x[0], cpu.x[1],
+            cpu.executed};
+        unsigned char header[sizeof magic + values * 8];
+        std::copy(magic, magic + sizeof magic, header);
+        unsigned char* p = header + sizeof magic;
+        for (auto value: state)
+        {
+            for (int shift = 56; shift >= 0; shift -= 8)
+                *p++ = static_cast<unsigned char>(value >> shift);
+        }
+        if (std::fwrite(header, 1, sizeof header, file) != sizeof header)
+            throw Snapshot_error("Cannot write " + path);
+        auto& code = cpu.cram.pages();
+        auto& data = cpu.dram.pages();
+        write_pages(file, code.data(), code.size(), code_offset(), path);
+        write_pages(file, data.data(), data.size(), data_offset(cpu.pm), path);
+    }
+    catch (...)
+    {
+        std::fclose(file);
+        throw;
+    }
+    if (std::fclose(file) != 0)
+        throw Snapshot_error("Cannot write " + path);
+}
+
+Snapshot::Snapshot(const string& path) : file {std::fopen(path.c_str(), "rb")}
+{
+    if (!file)
+        throw Snapshot_error("Cannot open " + path);
+    unsigned char header[sizeof magic + values * 8];
+    if (std::fread(header, 1, sizeof header, file) != sizeof header ||
+                            !std::equal(magic, magic + sizeof magic, header))
+    {
+        std::fclose(file);
+        throw Snapshot_error(path + " is not a snapshot");
+    }
+    const unsigned char* p = header + sizeof magic;
+    for (auto& value: saved)
+    {
+        value = 0;
+        for (int i = 0; i < 8; ++i)
+            value = value << 8 | *p++;
+    }
+}
+
+Snapshot::~Snapshot()
+{
+    std::fclose(file);
+}
+
+void Snapshot::restore(Cpu& cpu)
+{
+    if (saved[0] != cpu.pm)
+        throw Snapshot_error("The snapshot is for another size of memory");
+    cpu.cram.pages().map_file(file, code_offset());
+    cpu.dram.pages().map_file(file, data_offset(cpu.pm));
+    cpu.code_ram();
+    cpu.pc = saved[1];
+    cpu.r[0] = saved[2];
+    cpu.r[1] = saved[3];
+    cpu.s[0] = saved[4];
+    cpu.s[1] = saved[5];
+    cpu.x[0] = saved[6];
+    cpu.x[1] = saved[7];
+    cpu.executed = saved[8];
+}
+
+} // namespace vs
@@ -0,0 +1,78 @@
+// snapshot.hpp
+// Saved state of the virtual CPU
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef fauvisy_snapshot_hpp
+#define fauvisy_snapshot_hpp
+
+#include "cpu.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace vs
+{
+
+struct Snapshot_error
+{
+    std::string msg;
+    Snapshot_error(const std::string& msg): msg {msg}
+    {}
+};
+
+// The state of a Cpu saved in a file: its program counter, registers, pointer
+// mask, code memory and data memory. Restoring it maps both memories from the
+// file privately, so a Cpu can start again and again from a state that took
+// long to reach, such as a runtime after its startup, reading only the pages
+// it uses and copying only the ones it writes.
+class Snapshot
+{
+public:
+    // Writes the state of cpu to path, leaving pages of zeros as holes
+    static void save(Cpu& cpu, const std::string& path);
+    
+    // Opens a file written by save
+    explicit Snapshot(const std::string& path);
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+    ~Snapshot();
+    
+    // Puts cpu, which must have the same pointer mask, in the saved state.
+    // Whatever it wrote since the last restore is dropped.
+    void restore(Cpu& cpu);
+    
+private:
+    static constexpr unsigned values = 9;
+    
+    std::FILE* file;
+    std::uint_least64_t saved[values];
+};
+
+} // namespace vs
+
+#endif /* fauvisy_snapshot_hpp */
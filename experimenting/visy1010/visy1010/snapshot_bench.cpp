@@ -0,0 +1,128 @@
+// snapshot_bench.cpp
+// Micro-benchmark of snapshots
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "snapshot_bench.hpp"
+#include "snapshot.hpp"
+
+#include "using_containers.hpp"
+#include "using_cstdint.hpp"
+#include "using_iostream.hpp"
+#include "using_string.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+namespace vs
+{
+
+namespace
+{
+
+constexpr unsigned bits = 24;
+constexpr std::size_t initialized = 1 << 22;
+constexpr uint_least64_t stack = initialized + 0x1000;
+
+// The state of the runtime after its startup
+void boot(Cpu& cpu, const vector<uint_least8_t>& code,
+                                            const vector<uint_least8_t>& data)
+{
+    cpu.code_ram().load(code, 0);
+    cpu.sdata_ram().load(data, 0);
+    cpu.reset();
+    cpu.s0() = stack;
+}
+
+// Runs the test with value k, returning false if it goes wrong
+bool test(Cpu& cpu, uint_least64_t k)
+{
+    cpu.r0() = k;
+    Trap trap = cpu.loop();
+    return trap.cause == Trap::Cause::system && cpu.s0() == stack - 8 &&
+                                    cpu.sdata_ram().get64(stack - 8) == k;
+}
+
+}
+
+int bench_snapshot(std::ostream& out)
+{
+    using clock = std::chrono::steady_clock;
+    constexpr unsigned long starts = 2000;
+    string path = (std::filesystem::temp_directory_path() /
+                                        "visy1010_bench.snapshot").string();
+    
+    // pushd r0; sys r1, r0
+    vector<uint_least8_t> code {0x9d, 0x02};
+    vector<uint_least8_t> data(initialized);
+    for (std::size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<uint_least8_t>(i * 7 + (i >> 12));
+    Cpu cpu {bits};
+    boot(cpu, code, data);
+    Snapshot::save(cpu, path);
+    
+    auto start = clock::now();
+    for (unsigned long k = 0; k < starts; ++k)
+    {
+        cpu.sdata_ram().pages().clear();
+        boot(cpu, code, data);
+        if (!test(cpu, k))
+        {
+            out << "Wrong result of test " << k << " after loading\n";
+            std::remove(path.c_str());
+            return 1;
+        }
+    }
+    std::chrono::duration<double, std::micro> loading = clock::now() - start;
+    
+    Snapshot snapshot {path};
+    start = clock::now();
+    for (unsigned long k = 0; k < starts; ++k)
+    {
+        snapshot.restore(cpu);
+        if (!test(cpu, k) || cpu.sdata_ram().get8(initialized - 1) !=
+                                                    data[initialized - 1])
+        {
+            out << "Wrong result of test " << k << " after restoring\n";
+            std::remove(path.c_str());
+            return 1;
+        }
+    }
+    std::chrono::duration<double, std::micro> restoring = clock::now() - start;
+    std::remove(path.c_str());
+    
+    out << starts << " tests of a " << bits << "-bit system with " <<
+                (initialized >> 20) << " MiB of data after its startup\n";
+    out << std::fixed << std::setprecision(1);
+    out << "  loading images:  " << loading.count() / starts <<
+                                                            " us per test\n";
+    out << "  restoring:       " << restoring.count() / starts <<
+                                                            " us per test\n";
+    return 0;
+}
+
+}
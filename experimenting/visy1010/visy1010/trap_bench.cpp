@@ -0,0 +1,68 @@
+// trap_bench.cpp
+// Benchmark of system traps
+//
+// Created by Alejandro Castro Garcia on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "trap_bench.hpp"
+#include "cpu.hpp"
+
+#include "using_cstdint.hpp"
+#include "using_iostream.hpp"
+
+#include <chrono>
+
+namespace vs
+{
+
+int bench_traps(std::ostream& out)
+{
+    using clock = std::chrono::steady_clock;
+    constexpr unsigned long traps = 1ul << 22;
+    
+    // sys r1, r0; xorb r1, r1; jmp r1
+    Cpu cpu {12};
+    cpu.code_ram().load({0x02, 0xcb, 0x05}, 0);
+    cpu.reset();
+    auto start = clock::now();
+    for (unsigned long i = 0; i < traps; ++i)
+    {
+        Trap trap = cpu.loop();
+        if (trap.cause != Trap::Cause::system)
+        {
+            out << "Unexpected trap at 0x" << hex << trap.position << dec <<
+                                                                        "\n";
+            return 1;
+        }
+    }
+    std::chrono::duration<double, std::nano> t = clock::now() - start;
+    out << traps << " traps, " << cpu.instructions() << " instructions\n";
+    out << std::fixed << std::setprecision(1) << t.count() / traps <<
+        " ns per trap, with the two instructions that loop back to it\n";
+    return 0;
+}
+
+}
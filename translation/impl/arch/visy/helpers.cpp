@@ -0,0 +1,700 @@
+// helpers.cpp
+// Arithmetic helper routines for Visy
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "arch.hpp"
+#include "pieces.hpp"
+
+// Visy has no instructions to add, subtract, multiply or divide, so these
+// operations are calls to routines of the language library, generated here.
+// They follow the usual calling convention: operands are pushed from last to
+// first, the first one is also in R0 and the result is left in R0, extended
+// with zeros. Shift counts are ints; every other operand has the size of the
+// routine. R1, X0 and X1 are lost; S1 is kept.
+//
+// Additions go a byte at a time. The address adder finds the sum of two bytes
+// when one of them indexes a table whose entries hold their own position
+// modulo 256, and the carry is found with least, by checking whether the sum
+// wrapped around. Subtraction is ~(~a + b).
+//
+// Multiplication builds a table with the sixteen multiples of the first
+// operand, which only takes seven additions since even multiples are shifts,
+// and then goes through the second operand a nibble at a time: shifting the
+// result four bits to the left and adding the multiple for the next nibble.
+//
+// Division is restoring long division. Comparisons are done by least on whole
+// values, so only quotient bits set to one cost a subtraction. A nibble at a
+// time would need a table of multiples of the divisor, which costs more than
+// it saves unless operands are 64 bits long.
+
+namespace fauces
+{
+
+constexpr unsigned r0 = 0, r1 = 1, s0 = 0, s1 = 1, x0 = 0, x1 = 1;
+
+const string byte_sums = "__visy_byte_sums";
+
+static string helper_name(const string& operation, unsigned bits)
+{
+    return "__visy_" + operation + std::to_string(bits);
+}
+
+// Masks to change the sign of a value: zero, and a value with every bit set
+static string masks_name(unsigned bits)
+{
+    return helper_name("masks", bits);
+}
+
+static unsigned size_code(unsigned size)
+{
+    switch (size)
+    {
+        case 1:
+            return 0;
+        case 2:
+            return 1;
+        case 4:
+            return 2;
+        default:
+            return 3;
+    }
+}
+
+// Code of the library, one symbol after another. The linker places every
+// symbol on its own, so the code of a symbol must never run into the next.
+class Writer
+{
+public:
+    Writer(Translated_unit& unit): unit {unit}
+    {}
+    
+    void label(const string& name)
+    {
+        finish();
+        current = name;
+        start = static_cast<Location>(unit.code.size());
+    }
+    
+    void finish()
+    {
+        if (current.empty())
+            return;
+        Symbol& sym = unit.symbols[current];
+        sym.pos = start;
+        sym.size = static_cast<Size>(unit.code.size() - start);
+        sym.type = Sym_type::code;
+        current.clear();
+    }
+    
+    void table(const string& name, const vector<unsigned char>& bytes,
+                                                            Size alignment)
+    {
+        Symbol& sym = unit.symbols[name];
+        sym.pos = static_cast<Location>(unit.data.size());
+        sym.size = static_cast<Size>(bytes.size());
+        sym.type = Sym_type::data;
+        sym.alignment = alignment;
+        unit.data.insert(unit.data.end(), bytes.begin(), bytes.end());
+    }
+    
+    void andb(unsigned s, unsigned d) {op(0x30, s, d);}
+    void orb(unsigned s, unsigned d) {op(0x31, s, d);}
+    void xorb(unsigned s, unsigned d) {op(0x32, s, d);}
+    void notb(unsigned s, unsigned d) {op(0x33, s, d);}
+    void least(unsigned s, unsigned d) {op(0x34, s, d);}
+    void shl(unsigned s, unsigned d) {op(0x35, s, d);}
+    void shr(unsigned s, unsigned d) {op(0x36, s, d);}
+    void lm(unsigned size, unsigned s, unsigned d) {op(0x10 | size_code(size), s, d);}
+    void stm(unsigned size, unsigned s, unsigned d) {op(0x20 | size_code(size), s, d);}
+    void lrx(unsigned s, unsigned d) {op(0x18, s, d);}
+    void lrr(unsigned s, unsigned d) {op(0x1a, s, d);}
+    void lrs(unsigned s, unsigned d) {op(0x1b, s, d);}
+    void lsr(unsigned s, unsigned d) {op(0x1c, s, d);}
+    void push(unsigned size, unsigned s) {op(0x24 | size_code(size), s, 1);}
+    void pop(unsigned size, unsigned d) {op(0x14 | size_code(size), 1, d);}
+    void pushs(unsigned s) {op(0x29, s, 1);}
+    void pops(unsigned d) {op(0x19, 1, d);}
+    void jmp(unsigned d) {op(0x01, 0, d);}
+    void call(unsigned d) {op(0x02, 0, d);}
+    void ret() {op(0x03, 0, 0);}
+    void jmpz(unsigned s, unsigned d) {op(0x04, s, d);}
+    void jmpnz(unsigned s, unsigned d) {op(0x05, s, d);}
+    
+    void sori(unsigned imme, unsigned d)
+    {
+        unit.code.push_back(static_cast<unsigned char>(0xe0 | imme << 1 | d));
+    }
+    
+    void constant(std::uint_least64_t value, unsigned d)
+    {
+        xorb(d, d);
+        int shift = 60;
+        while (shift >= 0 && !(value >> shift & 0xf))
+            shift -= 4;
+        for (; shift >= 0; shift -= 4)
+            sori(value >> shift & 0xf, d);
+    }
+    
+    // What the register held moves above the 16 bits of the address, where
+    // it is ignored by every use of the address.
+    void address(const string& symbol, unsigned d)
+    {
+        auto pos = static_cast<Location>(unit.code.size() - start);
+        unit.symbols[current].references_to_others[symbol].
+                                emplace_back(Ref_type::four_halfbytes, pos);
+        for (int i = 0; i < 4; ++i)
+            sori(0, d);
+    }
+    
+    void jump_to(const string& symbol)
+    {
+        address(symbol, r1);
+        jmp(r1);
+    }
+    
+    void call_to(const string& symbol)
+    {
+        address(symbol, r1);
+        call(r1);
+    }
+    
+    // The frame of a routine starts at X1, which is set to S0.
+    void frame()
+    {
+        lsr(s0, r1);
+        lrx(r1, x1);
+    }
+    
+    void allocate(unsigned size)
+    {
+        for (unsigned part = 8; part; part /= 2)
+        {
+            for (; size >= part; size -= part)
+                op(0x24 | size_code(part), 0, 0);
+        }
+    }
+    
+    void release(unsigned size)
+    {
+        for (unsigned part = 8; part; part /= 2)
+        {
+            for (; size >= part; size -= part)
+                op(0x14 | size_code(part), 0, 0);
+        }
+    }
+    
+    // From the frame, through R1
+    void load(unsigned size, unsigned offset, unsigned d)
+    {
+        constant(offset, r1);
+        lm(size, r1, d);
+    }
+    
+    // R0 to the frame, through R1
+    void store(unsigned size, unsigned offset)
+    {
+        constant(offset, r1);
+        stm(size, r0, r1);
+    }
+    
+    // Keeps the lowest bits of R0, through R1
+    void truncate(unsigned bits)
+    {
+        if (bits < 64)
+        {
+            constant(64 - bits, r1);
+            shl(r1, r0);
+            shr(r1, r0);
+        }
+    }
+
+private:
+    Translated_unit& unit;
+    string current;
+    Location start = 0;
+    
+    void op(unsigned code, unsigned s, unsigned d)
+    {
+        unit.code.push_back(static_cast<unsigned char>(code << 2 | s << 1 | d));
+    }
+};
+
+// R0 = the byte in R0 plus the one in X0, modulo 256. S1 holds the table.
+static void sum_byte(Writer& w)
+{
+    w.lsr(s1, r1);
+    w.orb(r1, r0);
+    w.lm(1, r0, r0);
+}
+
+// X0 = the lowest bit of R1, through R0
+static void carry_to_x0(Writer& w)
+{
+    w.constant(1, r0);
+    w.andb(r0, r1);
+    w.lrx(r1, x0);
+}
+
+// Adds the value of some bytes at offset b in the frame to the one at offset
+// a, leaving the sum at a. S1 must hold the address of the table of sums.
+static void add_bytes(Writer& w, unsigned bytes, unsigned a, unsigned b)
+{
+    unsigned last = bytes - 1;
+    
+    // Nothing is carried into the least significant byte, and there is a
+    // carry out of it if the sum is lower than one of the addends.
+    w.load(1, b + last, r0);
+    w.lrx(r0, x0);
+    w.load(1, a + last, r0);
+    sum_byte(w);
+    w.store(1, a + last);
+    if (bytes > 1)
+    {
+        w.load(1, b + last, r1);
+        w.least(r0, r1);
+        carry_to_x0(w);
+    }
+    
+    // The rest add the carry and then the byte of b. At most one of both
+    // additions can wrap around: the carry out is the lowest bit of the
+    // result of least for either of them.
+    for (unsigned i = last; i-- > 0;)
+    {
+        bool carry_out = i > 0;
+        w.load(1, a + i, r0);
+        sum_byte(w);
+        if (carry_out)
+        {
+            w.load(1, a + i, r1);
+            w.least(r0, r1);
+            w.push(1, r1);
+            w.push(1, r0);
+        }
+        w.load(1, b + i, r1);
+        w.lrx(r1, x0);
+        sum_byte(w);
+        w.store(1, a + i);
+        if (carry_out)
+        {
+            w.pop(1, r1);
+            w.least(r0, r1);
+            w.pop(1, r0);
+            w.orb(r0, r1);
+            carry_to_x0(w);
+        }
+    }
+}
+
+// Saves S1, to hold the table of sums, and sets the frame after allocating
+// some bytes for local values
+static void enter(Writer& w, unsigned locals)
+{
+    w.pushs(s1);
+    w.allocate(locals);
+    w.frame();
+    w.address(byte_sums, r1);
+    w.lrs(r1, s1);
+}
+
+static void leave(Writer& w, unsigned locals)
+{
+    w.release(locals);
+    w.pops(s1);
+    w.ret();
+}
+
+// Value at offset = -value, if the one at cond, of the same size, is 1, and
+// left alone if it is 0
+static void negate_if(Writer& w, unsigned bits, unsigned offset, unsigned cond)
+{
+    unsigned n = bits / 8;
+    w.load(n, cond, r1);
+    w.constant(3, r0);
+    w.shl(r0, r1);
+    w.lrx(r1, x0);
+    w.address(masks_name(bits), r0);
+    w.lm(8, r0, r0);
+    w.load(n, offset, r1);
+    w.xorb(r0, r1);
+    w.lrr(r1, r0);
+    w.store(n, offset);
+    add_bytes(w, n, offset, cond);
+}
+
+// Operands of binary routines, after S1 and the return address
+static constexpr unsigned first = 4;
+
+static void add_routine(Writer& w, unsigned bits)
+{
+    unsigned n = bits / 8;
+    w.label(helper_name("add", bits));
+    enter(w, 0);
+    add_bytes(w, n, first, first + n);
+    w.load(n, first, r0);
+    leave(w, 0);
+}
+
+static void sub_routine(Writer& w, unsigned bits)
+{
+    unsigned n = bits / 8;
+    w.label(helper_name("sub", bits));
+    enter(w, 0);
+    w.load(n, first, r0);
+    w.notb(r0, r0);
+    w.store(n, first);
+    add_bytes(w, n, first, first + n);
+    w.load(n, first, r0);
+    w.notb(r0, r0);
+    w.truncate(bits);
+    leave(w, 0);
+}
+
+static void mul_routine(Writer& w, unsigned bits)
+{
+    unsigned n = bits / 8;
+    string add = helper_name("mul", bits) + "_add";
+    
+    // Frame: multiples, result, S1, return address and operands. Once the
+    // multiples are known, the place of the first operand holds the one to
+    // be added next.
+    unsigned result = 16 * n;
+    unsigned locals = 17 * n;
+    unsigned a = locals + first;
+    unsigned b = a + n;
+    w.label(helper_name("mul", bits));
+    enter(w, locals);
+    w.xorb(r0, r0);
+    w.store(n, 0);
+    w.load(n, a, r0);
+    w.store(n, n);
+    for (unsigned k = 1; k < 8; ++k)
+    {
+        w.load(n, k * n, r0);
+        w.constant(1, r1);
+        w.shl(r1, r0);
+        w.store(n, 2 * k * n);
+        w.store(n, result);
+        w.call_to(add);
+        w.load(n, result, r0);
+        w.store(n, (2 * k + 1) * n);
+    }
+    
+    // Nibbles from the most significant one, each one selecting a multiple
+    // through X0, which points to the table
+    unsigned scale = size_code(n);
+    for (unsigned i = bits / 4; i-- > 0;)
+    {
+        w.load(n, b, r0);
+        if (4 * i > scale)
+        {
+            w.constant(4 * i - scale, r1);
+            w.shr(r1, r0);
+        }
+        else if (4 * i < scale)
+        {
+            w.constant(scale - 4 * i, r1);
+            w.shl(r1, r0);
+        }
+        w.constant(0xf << scale, r1);
+        w.andb(r1, r0);
+        w.lsr(s0, r1);
+        w.lrx(r1, x0);
+        w.lm(n, r0, r0);
+        if (i == bits / 4 - 1)
+            w.store(n, result);
+        else
+        {
+            w.store(n, a);
+            w.load(n, result, r0);
+            w.constant(4, r1);
+            w.shl(r1, r0);
+            w.store(n, result);
+            w.call_to(add);
+        }
+    }
+    w.load(n, result, r0);
+    leave(w, locals);
+    
+    // Result += value at the place of the first operand, in the frame of the
+    // caller
+    w.label(add);
+    add_bytes(w, n, result, a);
+    w.ret();
+}
+
+// Besides returning the quotient, leaves it in the place of the first operand
+// and the remainder in the place of the second one, for the other routines
+// of division.
+static void udiv_routine(Writer& w, unsigned bits)
+{
+    unsigned n = bits / 8;
+    string name = helper_name("udiv", bits);
+    string step = name + "_step";
+    string next = name + "_next";
+    
+    // Frame: divisor, mask of the bit of the quotient being found, and the
+    // highest bit of the remainder before shifting it, which can only be one
+    // with 64 bits. The quotient is built where the dividend was, which is
+    // shifted out at the same pace, and the remainder where the divisor was.
+    unsigned divisor = 0;
+    unsigned mask = n;
+    unsigned high = 2 * n;
+    unsigned locals = bits == 64 ? 2 * n + 2 : 2 * n;
+    unsigned q = locals + first;
+    unsigned r = q + n;
+    w.label(name);
+    enter(w, locals);
+    w.load(n, r, r0);
+    w.store(n, divisor);
+    w.xorb(r0, r0);
+    w.store(n, r);
+    w.constant(std::uint_least64_t {1} << (bits - 1), r0);
+    w.store(n, mask);
+    w.jump_to(step);
+    
+    // Remainder and quotient, as a whole, move a bit to the left.
+    w.label(step);
+    w.load(n, q, r0);
+    w.constant(bits - 1, r1);
+    w.shr(r1, r0);
+    w.push(1, r0);
+    w.load(n, q, r0);
+    w.constant(1, r1);
+    w.shl(r1, r0);
+    w.store(n, q);
+    if (bits == 64)
+    {
+        w.load(n, r, r0);
+        w.constant(63, r1);
+        w.shr(r1, r0);
+        w.store(1, high);
+    }
+    w.load(n, r, r0);
+    w.constant(1, r1);
+    w.shl(r1, r0);
+    w.pop(1, r1);
+    w.orb(r1, r0);
+    w.store(n, r);
+    
+    // Unless the remainder is now lower than the divisor, subtract it and
+    // set the bit of the quotient. Shorter than 64 bits, R0 still has the
+    // highest bit of the remainder, which was not stored.
+    w.load(n, divisor, r1);
+    w.least(r0, r1);
+    w.constant(1, r0);
+    w.xorb(r0, r1);
+    if (bits == 64)
+    {
+        w.lrr(r1, r0);
+        w.load(1, high, r1);
+        w.orb(r1, r0);
+        w.address(next, r1);
+        w.jmpz(r0, r1);
+    }
+    else
+    {
+        w.address(next, r0);
+        w.jmpz(r1, r0);
+    }
+    w.load(n, r, r0);
+    w.notb(r0, r0);
+    w.store(n, r);
+    add_bytes(w, n, r, divisor);
+    w.load(n, r, r0);
+    w.notb(r0, r0);
+    w.store(n, r);
+    w.load(1, q + n - 1, r0);
+    w.constant(1, r1);
+    w.orb(r1, r0);
+    w.store(1, q + n - 1);
+    w.jump_to(next);
+    
+    w.label(next);
+    w.load(n, mask, r0);
+    w.constant(1, r1);
+    w.shr(r1, r0);
+    w.store(n, mask);
+    w.address(step, r1);
+    w.jmpnz(r0, r1);
+    w.load(n, q, r0);
+    leave(w, locals);
+}
+
+// Operands are copied for udiv, which changes them.
+static void umod_routine(Writer& w, unsigned bits)
+{
+    unsigned n = bits / 8;
+    w.label(helper_name("umod", bits));
+    w.frame();
+    w.load(n, 2 + n, r0);
+    w.push(n, r0);
+    w.load(n, 2, r0);
+    w.push(n, r0);
+    w.call_to(helper_name("udiv", bits));
+    w.release(n);
+    w.pop(n, r0);
+    w.ret();
+}
+
+// Division of absolute values, and then the sign of the result is set: the
+// quotient is negative if operands have different signs, and the remainder
+// has the sign of the dividend.
+static void signed_division(Writer& w, unsigned bits, bool remainder)
+{
+    unsigned n = bits / 8;
+    
+    // Frame: a value of the size of operands, used to change their signs,
+    // and the sign of the result
+    unsigned cond = 0;
+    unsigned sign = n;
+    unsigned locals = n + 2;
+    unsigned a = locals + first;
+    unsigned b = a + n;
+    w.label(helper_name(remainder ? "mod" : "div", bits));
+    enter(w, locals);
+    w.load(n, a, r0);
+    w.constant(bits - 1, r1);
+    w.shr(r1, r0);
+    w.store(n, cond);
+    w.store(1, sign);
+    negate_if(w, bits, a, cond);
+    w.load(n, b, r0);
+    w.constant(bits - 1, r1);
+    w.shr(r1, r0);
+    w.store(n, cond);
+    if (!remainder)
+    {
+        w.load(1, sign, r1);
+        w.xorb(r1, r0);
+        w.store(1, sign);
+    }
+    negate_if(w, bits, b, cond);
+    w.load(n, b, r0);
+    w.push(n, r0);
+    w.load(n, a, r0);
+    w.push(n, r0);
+    
+    // The routine sets X1 to its own frame.
+    w.call_to(helper_name("udiv", bits));
+    if (remainder)
+    {
+        w.release(n);
+        w.pop(n, r0);
+    }
+    else
+    {
+        w.pop(n, r0);
+        w.release(n);
+    }
+    w.frame();
+    w.store(n, a);
+    w.load(1, sign, r0);
+    w.store(n, cond);
+    negate_if(w, bits, a, cond);
+    w.load(n, a, r0);
+    leave(w, locals);
+}
+
+// The count is an int, after the value to shift.
+static void shl_routine(Writer& w, unsigned bits)
+{
+    unsigned n = bits / 8;
+    w.label(helper_name("shl", bits));
+    w.frame();
+    w.load(2, 2 + n, r1);
+    w.shl(r1, r0);
+    w.truncate(bits);
+    w.ret();
+}
+
+static void shr_routine(Writer& w, unsigned bits)
+{
+    unsigned n = bits / 8;
+    w.label(helper_name("shr", bits));
+    w.frame();
+    w.load(n, 2, r0);
+    w.load(2, 2 + n, r1);
+    w.shr(r1, r0);
+    w.ret();
+}
+
+// Negative values are complemented before and after shifting them.
+static void sar_routine(Writer& w, unsigned bits)
+{
+    unsigned n = bits / 8;
+    w.label(helper_name("sar", bits));
+    w.frame();
+    w.load(n, 2, r1);
+    w.constant(bits - 4, r0);
+    w.shr(r0, r1);
+    w.constant(8, r0);
+    w.andb(r0, r1);
+    w.lrx(r1, x0);
+    w.address(masks_name(bits), r0);
+    w.lm(8, r0, r0);
+    w.push(8, r0);
+    w.load(n, 2, r1);
+    w.xorb(r0, r1);
+    w.lrr(r1, r0);
+    w.load(2, 2 + n, r1);
+    w.shr(r1, r0);
+    w.pop(8, r1);
+    w.xorb(r1, r0);
+    w.ret();
+}
+
+}
+
+auto fauces::arch::Visy::language_library() -> unique_ptr<Translated_unit>
+{
+    auto unit = make_unique<Translated_unit>();
+    Writer w {*unit};
+    vector<unsigned char> sums(512);
+    for (size_t i = 0; i < sums.size(); ++i)
+        sums[i] = static_cast<unsigned char>(i);
+    w.table(byte_sums, sums, 256);
+    for (unsigned bits: {16, 32, 64})
+    {
+        vector<unsigned char> masks(16);
+        for (unsigned i = 16 - bits / 8; i < 16; ++i)
+            masks[i] = 0xff;
+        w.table(masks_name(bits), masks, 1);
+        add_routine(w, bits);
+        sub_routine(w, bits);
+        mul_routine(w, bits);
+        udiv_routine(w, bits);
+        umod_routine(w, bits);
+        signed_division(w, bits, false);
+        signed_division(w, bits, true);
+        shl_routine(w, bits);
+        shr_routine(w, bits);
+        sar_routine(w, bits);
+    }
+    w.finish();
+    return unit;
+}
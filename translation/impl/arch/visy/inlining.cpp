@@ -0,0 +1,264 @@
+// inlining.cpp
+// Link-time inlining for Visy
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "arch.hpp"
+#include "pieces.hpp"
+
+#include <algorithm>
+
+// With every unit of the program at hand, calls to tiny functions defined in
+// any unit can be replaced by the body of the function, when it is not
+// longer than the code needed to call it: the address of the function
+// loaded into R1 with four sori instructions, and the call itself.
+// Then the peephole pass runs again on the changed units, which propagates
+// constants across what used to be a call, and functions that are no longer
+// called are left out by the linker as usual.
+//
+// A body can be inlined if it ends with its only ret and everything before
+// does nothing but change R registers and memory: no stack, no control
+// transfer and no references. It must not read R1 before writing it,
+// because it would find the address of the function there, and arguments
+// only matter in R0, since the stack is never looked at.
+
+namespace fauces
+{
+
+constexpr size_t call_size = 5;
+
+struct Inline_body
+{
+    vector<unsigned char> bytes;    // Without ret
+};
+
+static inline unsigned opcode(unsigned char byte)
+{
+    return byte >> 2;
+}
+
+// Registers read and written by instructions acceptable in a body
+static bool register_use(unsigned char byte, unsigned& reads, unsigned& writes)
+{
+    unsigned s = 1u << ((byte >> 1) & 1);
+    unsigned d = 1u << (byte & 1);
+    unsigned op = opcode(byte);
+    reads = writes = 0;
+    if (op >= 0x38)                                     // sori
+        reads = writes = d;
+    else if (op >= 0x10 && op <= 0x13)                  // lm*
+    {
+        reads = s;
+        writes = d;
+    }
+    else if (op == 0x18)                                // lrx
+        reads = s;
+    else if (op == 0x1a || op == 0x33)                  // lrr, notb
+    {
+        reads = s;
+        writes = d;
+    }
+    else if ((op >= 0x20 && op <= 0x23) || op == 0x2a)  // stm*, strr
+        reads = s | d;
+    else if (op == 0x32 && s == d)                      // xorb to zero
+        writes = d;
+    else if (op >= 0x30 && op <= 0x36)
+    {
+        reads = s | d;
+        writes = d;
+    }
+    else
+        return false;
+    return true;
+}
+
+static bool inlinable(Translated_unit& unit, const Symbol& sym,
+                                                            Inline_body& body)
+{
+    if (sym.size < 1 || sym.size > call_size + 1 ||
+                                            !sym.references_to_others.empty())
+        return false;
+    auto first = unit.code.begin() + sym.pos;
+    if (first[sym.size - 1] != 0x0c)                    // ret
+        return false;
+    unsigned written = 0;
+    for (Size i = 0; i + 1 < sym.size; ++i)
+    {
+        unsigned reads, writes;
+        if (!register_use(first[i], reads, writes))
+            return false;
+        if (reads & ~written & 2)
+            return false;
+        written |= writes;
+    }
+    for (auto& [name, other]: unit.symbols)
+    {
+        // Labels or references inside would be lost.
+        if (&other != &sym && other.type == Sym_type::code &&
+                !other.is_external() &&
+                within<Location>(other.pos, sym.pos + 1, sym.size - 1))
+            return false;
+        for (auto& ref: other.references_in_code)
+        {
+            if (within<Location>(ref.pos, sym.pos, sym.size))
+                return false;
+        }
+    }
+    body.bytes.assign(first, first + sym.size - 1);
+    return true;
+}
+
+// Whether a reference is the address of a call: four sori into R1, followed
+// by a call through it, all inside the calling symbol. Bodies are only
+// checked not to read R1 before writing it, so calls through R0 are left.
+static bool is_call(const Translated_unit& unit, const Symbol& caller,
+                                                        const Reference& ref)
+{
+    if (ref.type != Ref_type::four_halfbytes ||
+                                    ref.pos + call_size > caller.size)
+        return false;
+    auto at = unit.code.begin() + caller.pos + ref.pos;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        if (opcode(at[i]) < 0x38 || (at[i] & 1) != 1)
+            return false;
+    }
+    if (at[4] != 0x09)                                  // call r1
+        return false;
+    for (auto& [name, other]: unit.symbols)
+    {
+        // Nobody may jump into the middle of the sequence.
+        if (other.type == Sym_type::code &&
+                within<Location>(other.pos, caller.pos + ref.pos + 1, 4))
+            return false;
+    }
+    return true;
+}
+
+struct Replacement
+{
+    Location pos;       // In the code of the unit
+    const Inline_body* body;
+};
+
+// Moves symbols and references after replacing calls by shorter bodies
+static void replace_calls(Translated_unit& unit,
+                                        vector<Replacement>& replacements)
+{
+    std::sort(replacements.begin(), replacements.end(),
+                    [](auto& a, auto& b) {return a.pos < b.pos;});
+    auto& code = unit.code;
+    vector<unsigned char> result;
+    vector<Location> new_pos(code.size() + 1);
+    size_t next = 0;
+    for (size_t i = 0; i <= code.size();)
+    {
+        if (next < replacements.size() && replacements[next].pos == i)
+        {
+            auto& bytes = replacements[next++].body->bytes;
+            for (size_t j = 0; j < call_size; ++j)
+                new_pos[i + j] = static_cast<Location>(result.size());
+            result.insert(result.end(), bytes.begin(), bytes.end());
+            i += call_size;
+            continue;
+        }
+        new_pos[i] = static_cast<Location>(result.size());
+        if (i < code.size())
+            result.push_back(code[i]);
+        ++i;
+    }
+    code = std::move(result);
+    for (auto& [name, sym]: unit.symbols)
+    {
+        for (auto& ref: sym.references_in_code)
+            ref.pos = new_pos.at(ref.pos);
+        if (sym.type != Sym_type::code || sym.is_external())
+            continue;
+        Location start = new_pos.at(sym.pos);
+        for (auto& [other, refs]: sym.references_to_others)
+            for (auto& ref: refs)
+                ref.pos = new_pos.at(sym.pos + ref.pos) - start;
+        sym.size = new_pos.at(sym.pos + sym.size) - start;
+        sym.pos = start;
+    }
+}
+
+} // namespace fauces
+
+void fauces::arch::Visy::optimize_program(vector<Translated_unit*>& units)
+{
+    unordered_map<string, Inline_body> bodies;
+    for (auto unit: units)
+    {
+        for (auto& [name, sym]: unit->symbols)
+        {
+            Inline_body body;
+            if (sym.type == Sym_type::code && !sym.is_external() &&
+                                                inlinable(*unit, sym, body))
+                bodies.emplace(name, std::move(body));
+        }
+    }
+    if (bodies.empty())
+        return;
+    
+    for (auto unit: units)
+    {
+        vector<Replacement> replacements;
+        for (auto& [name, sym]: unit->symbols)
+        {
+            if (sym.type != Sym_type::code || sym.is_external())
+                continue;
+            for (auto refs = sym.references_to_others.begin();
+                                refs != sym.references_to_others.end();)
+            {
+                auto body = bodies.find(refs->first);
+                auto& list = refs->second;
+                if (body != bodies.end() && refs->first != name)
+                {
+                    auto kept = std::remove_if(list.begin(), list.end(),
+                        [&](const Reference& ref)
+                        {
+                            if (!is_call(*unit, sym, ref))
+                                return false;
+                            Location pos = sym.pos + ref.pos;
+                            replacements.push_back({pos, &body->second});
+                            return true;
+                        });
+                    list.erase(kept, list.end());
+                }
+                if (list.empty())
+                    refs = sym.references_to_others.erase(refs);
+                else
+                    ++refs;
+            }
+        }
+        if (replacements.empty())
+            continue;
+        replace_calls(*unit, replacements);
+        optimize(*unit);
+    }
+}
@@ -0,0 +1,504 @@
+// peephole.cpp
+// Peephole optimization of Visy machine code
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "arch.hpp"
+#include "pieces.hpp"
+
+#include <optional>
+#include <algorithm>
+
+// Code for Visy is full of constants built from chains of one-byte
+// instructions, because there is no instruction to load an immediate value
+// into a register. This pass removes the most obvious waste from the code
+// section of a translated unit, before it gets relocated:
+//
+// * Register loads whose result is overwritten before being used.
+// * Push/pop pairs that leave everything as it was.
+// * Constants loaded into a register that already holds the same value.
+// * Calls right before a return, from a function that has pushed nothing
+//   onto the stack, which become jumps: the callee then returns directly to
+//   our caller, saving a return address round trip and an instruction. As
+//   arguments go on the stack, this is only possible for calls without them.
+//
+// The pass never looks across symbol boundaries, which are the only places
+// where control can arrive from elsewhere, and never touches a byte that is
+// the target of a reference. Symbols and references are moved to account for
+// the removed bytes.
+
+namespace fauces
+{
+
+using Value = std::optional<std::uint_least64_t>;
+
+enum class Peep_kind
+{
+    barrier,    // Control transfer, system trap or unknown instruction
+    other,      // Effects we do not track: memory, stack, S and X registers
+    pure        // Only writes an R register, reading R or S registers
+};
+
+struct Peep_instruction
+{
+    Peep_kind kind;
+    unsigned reads;     // Mask of R registers read
+    unsigned writes;    // Mask of R registers written
+};
+
+struct Peep_slot
+{
+    unsigned char byte;
+    bool pinned = false;    // Part of a reference
+    bool boundary = false;  // A symbol starts here
+    bool entry = false;     // A function starts here
+    bool removed = false;
+};
+
+enum: unsigned char
+{
+    op_jmp = 0x01,
+    op_call = 0x02,
+    op_ret = 0x03,
+    op_jmpz = 0x04,
+    op_jmpnz = 0x05,
+    op_popd = 0x17,
+    op_lrr = 0x1a,
+    op_pushd = 0x27,
+    op_xorb = 0x32,
+    op_notb = 0x33,
+    op_sori = 0x38
+};
+
+static inline unsigned opcode(unsigned char byte)
+{
+    return byte >> 2;
+}
+
+static inline unsigned src(unsigned char byte)
+{
+    return (byte >> 1) & 1;
+}
+
+static inline unsigned dst(unsigned char byte)
+{
+    return byte & 1;
+}
+
+static inline unsigned bit(unsigned reg)
+{
+    return 1u << reg;
+}
+
+static Peep_instruction decode(unsigned char byte)
+{
+    unsigned s = src(byte);
+    unsigned d = dst(byte);
+    unsigned op = opcode(byte);
+    if (op >= op_sori)
+        return {Peep_kind::pure, bit(d), bit(d)};
+    switch (op)
+    {
+        case 0x10: case 0x11: case 0x12: case 0x13:     // lm*
+            return {Peep_kind::other, bit(s), bit(d)};
+        case 0x14: case 0x15: case 0x16: case 0x17:     // pop*
+            return {Peep_kind::other, 0, s ? bit(d) : 0};
+        case 0x18: case 0x1b:                           // lrx, lrs
+            return {Peep_kind::other, bit(s), 0};
+        case 0x19: case 0x29:                           // pops, pushs
+            return {Peep_kind::other, 0, 0};
+        case 0x1a: case 0x33:                           // lrr, notb
+            return {Peep_kind::pure, bit(s), bit(d)};
+        case 0x1c:                                      // lsr
+            return {Peep_kind::pure, 0, bit(d)};
+        case 0x20: case 0x21: case 0x22: case 0x23:     // stm*
+        case 0x2a:                                      // strr
+            return {Peep_kind::other, bit(s) | bit(d), 0};
+        case 0x24: case 0x25: case 0x26: case 0x27:     // push*
+            return {Peep_kind::other, d ? bit(s) : 0, 0};
+        case 0x2b:                                      // strs
+            return {Peep_kind::other, bit(s), 0};
+        case 0x2c:                                      // stsr
+            return {Peep_kind::other, bit(d), 0};
+        case 0x32:                                      // xorb
+            if (s == d)
+                return {Peep_kind::pure, 0, bit(d)};
+            [[fallthrough]];
+        case 0x30: case 0x31: case 0x34: case 0x35: case 0x36:
+            return {Peep_kind::pure, bit(s) | bit(d), bit(d)};
+        default:
+            return {Peep_kind::barrier, 0, 0};
+    }
+}
+
+// Result of a pure instruction, if it can be known
+static Value evaluate(unsigned char byte, const Value r[2])
+{
+    constexpr std::uint_least64_t mask = 0xffff'ffff'ffff'ffff;
+    const Value& a = r[src(byte)];
+    const Value& b = r[dst(byte)];
+    unsigned op = opcode(byte);
+    if (op >= op_sori)
+    {
+        if (!b)
+            return {};
+        return ((*b << 4) & mask) | ((byte >> 1) & 0xf);
+    }
+    if (op == op_xorb && src(byte) == dst(byte))
+        return 0;
+    if (op == op_lrr)
+        return a;
+    if (op == op_notb)
+    {
+        if (!a)
+            return {};
+        return ~*a & mask;
+    }
+    if (!a || !b)
+        return {};
+    switch (op)
+    {
+        case 0x30:
+            return *b & *a;
+        case 0x31:
+            return *b | *a;
+        case 0x32:
+            return *b ^ *a;
+        case 0x34:
+            return *a == *b ? 0 : *a < *b ? 1 : 2;
+        case 0x35:
+            return (*b << (*a & 63)) & mask;
+        case 0x36:
+            return *b >> (*a & 63);
+        default:
+            return {};
+    }
+}
+
+static size_t next(const vector<Peep_slot>& slots, size_t i)
+{
+    while (++i < slots.size() && slots[i].removed)
+        ;
+    return i;
+}
+
+// Symbols starting at a removed byte end up at the next kept one, so that is
+// where control arrives from elsewhere now. Removed slots never keep a flag.
+static void remove(vector<Peep_slot>& slots, size_t i)
+{
+    slots[i].removed = true;
+    size_t j = next(slots, i);
+    if (j < slots.size())
+    {
+        slots[j].boundary = slots[j].boundary || slots[i].boundary;
+        slots[j].entry = slots[j].entry || slots[i].entry;
+    }
+    slots[i].boundary = slots[i].entry = false;
+}
+
+// Instruction following i, when both always execute one after the other
+static size_t follower(const vector<Peep_slot>& slots, size_t i)
+{
+    size_t j = next(slots, i);
+    if (j < slots.size() && slots[j].boundary)
+        return slots.size();
+    return j;
+}
+
+static bool remove_push_pop(vector<Peep_slot>& slots)
+{
+    bool changed = false;
+    for (size_t i = 0; i < slots.size(); i = next(slots, i))
+    {
+        size_t j = follower(slots, i);
+        if (slots[i].removed || j == slots.size() || slots[i].pinned ||
+                                                            slots[j].pinned)
+            continue;
+        unsigned char push = slots[i].byte;
+        unsigned char pop = slots[j].byte;
+        unsigned width = opcode(push) - 0x24;
+        if (width > 3 || opcode(pop) != 0x14 + width)
+            continue;
+        if (!dst(push) && !src(pop))
+        {
+            // The stack pointer goes down and up again.
+            remove(slots, i);
+            remove(slots, j);
+            changed = true;
+        }
+        else if (opcode(push) == op_pushd && dst(push) && src(pop))
+        {
+            // Only a 64-bit round trip keeps the whole register.
+            if (src(push) == dst(pop))
+                remove(slots, i);
+            else
+                slots[i].byte = static_cast<unsigned char>
+                            ((op_lrr << 2) | (src(push) << 1) | dst(pop));
+            remove(slots, j);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static bool remove_dead_writes(vector<Peep_slot>& slots)
+{
+    bool changed = false;
+    for (size_t i = 0; i < slots.size(); i = next(slots, i))
+    {
+        if (slots[i].removed || slots[i].pinned)
+            continue;
+        auto ins = decode(slots[i].byte);
+        if (ins.kind != Peep_kind::pure)
+            continue;
+        size_t j = follower(slots, i);
+        if (j == slots.size())
+            continue;
+        unsigned char byte = slots[j].byte;
+        auto later = decode(byte);
+        bool dead;
+        if (later.kind == Peep_kind::barrier)
+            // The callee does not need to preserve R1.
+            dead = byte == op_ret << 2 && ins.writes == bit(1);
+        else
+            dead = (later.writes & ins.writes) && !(later.reads & ins.writes);
+        if (dead)
+        {
+            remove(slots, i);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// A run of instructions that only read and write the same register
+static bool in_run(const Peep_slot& slot, unsigned d)
+{
+    auto ins = decode(slot.byte);
+    return !slot.pinned && ins.kind == Peep_kind::pure &&
+                            ins.writes == bit(d) && (ins.reads & ~bit(d)) == 0;
+}
+
+static bool remove_reloads(vector<Peep_slot>& slots)
+{
+    bool changed = false;
+    Value r[2];
+    for (size_t i = 0; i < slots.size(); i = next(slots, i))
+    {
+        if (slots[i].removed)
+            continue;
+        if (slots[i].boundary)
+            r[0] = r[1] = Value {};
+        unsigned char byte = slots[i].byte;
+        auto ins = decode(byte);
+        if (ins.kind == Peep_kind::barrier)
+        {
+            r[0] = r[1] = Value {};
+            continue;
+        }
+        if (ins.kind == Peep_kind::other || slots[i].pinned)
+        {
+            for (unsigned n = 0; n < 2; ++n)
+                if (ins.writes & bit(n))
+                    r[n] = Value {};
+            continue;
+        }
+        unsigned d = dst(byte);
+        if (r[d] && in_run(slots[i], d))
+        {
+            // Find the longest run that ends with the value it started with.
+            Value start = r[d];
+            Value v[2] {r[0], r[1]};
+            size_t last = slots.size();
+            for (size_t j = i; j < slots.size() && in_run(slots[j], d);
+                                                        j = follower(slots, j))
+            {
+                v[d] = evaluate(slots[j].byte, v);
+                if (v[d] == start)
+                    last = j;
+            }
+            if (last != slots.size())
+            {
+                for (size_t j = i; j <= last; j = next(slots, j))
+                    remove(slots, j);
+                changed = true;
+                i = last;
+                continue;
+            }
+        }
+        Value result = evaluate(byte, r);
+        if (result && result == r[d])
+        {
+            remove(slots, i);
+            changed = true;
+        }
+        else
+            r[d] = result;
+    }
+    return changed;
+}
+
+// Bytes pushed onto the stack by an instruction that does not transfer
+// control, if known
+static std::optional<int> stack_change(unsigned char byte)
+{
+    constexpr int address_size = arch::Visy::address_bits / 8;
+    unsigned op = opcode(byte);
+    if (op >= 0x24 && op <= 0x27)                       // push*
+        return 1 << (op - 0x24);
+    if (op >= 0x14 && op <= 0x17)                       // pop*
+        return -(1 << (op - 0x14));
+    if (op == 0x29)                                     // pushs
+        return address_size;
+    if (op == 0x19 && dst(byte) != 0)                   // pops S1
+        return -address_size;
+    if (op == 0x19 || (op == 0x1b && dst(byte) == 0))   // S0 replaced
+        return {};
+    return 0;
+}
+
+static bool make_tail_calls(vector<Peep_slot>& slots)
+{
+    bool changed = false;
+    std::optional<int> pushed;
+    for (size_t i = 0; i < slots.size(); i = next(slots, i))
+    {
+        if (slots[i].removed)
+            continue;
+        if (slots[i].boundary)
+            // Elsewhere the stack may be different.
+            pushed = slots[i].entry ? std::optional<int> {0} : std::nullopt;
+        unsigned char byte = slots[i].byte;
+        unsigned op = opcode(byte);
+        if (op == op_call && pushed == 0)
+        {
+            size_t j = follower(slots, i);
+            if (j < slots.size() && slots[j].byte == op_ret << 2 &&
+                                    !slots[i].pinned && !slots[j].pinned)
+            {
+                slots[i].byte = static_cast<unsigned char>
+                                                    ((op_jmp << 2) | dst(byte));
+                remove(slots, j);
+                changed = true;
+                continue;
+            }
+        }
+        if (op == op_call || slots[i].pinned)
+            // The callee leaves the stack as it was.
+            continue;
+        if (decode(byte).kind == Peep_kind::barrier && op != op_jmpz &&
+                                                                op != op_jmpnz)
+            pushed = {};
+        else if (pushed)
+        {
+            auto change = stack_change(byte);
+            pushed = change ? std::optional<int> {*pushed + *change} :
+                                                                std::nullopt;
+        }
+    }
+    return changed;
+}
+
+static void pin(vector<Peep_slot>& slots, const Reference& ref, Location base)
+{
+    size_t size = ref.type == Ref_type::two_bytes ? 2 : 4;
+    for (size_t i = 0; i < size; ++i)
+        slots.at(base + ref.pos + i).pinned = true;
+}
+
+} // namespace fauces
+
+void fauces::arch::Visy::optimize(Translated_unit& unit)
+{
+    auto& code = unit.code;
+    vector<Peep_slot> slots;
+    for (auto byte: code)
+        slots.push_back({byte});
+    vector<std::pair<Location, Size>> functions;
+    for (auto& [name, sym]: unit.symbols)
+    {
+        for (auto& ref: sym.references_in_code)
+            pin(slots, ref, 0);
+        if (sym.type != Sym_type::code || sym.is_external())
+            continue;
+        functions.push_back({sym.pos, sym.size});
+        if (sym.pos < slots.size())
+            slots[sym.pos].boundary = true;
+        if (sym.pos + sym.size < slots.size())
+            slots[sym.pos + sym.size].boundary = true;
+        for (auto& [other, refs]: sym.references_to_others)
+            for (auto& ref: refs)
+                pin(slots, ref, sym.pos);
+    }
+    
+    // Code symbols inside others are labels, not functions.
+    std::sort(functions.begin(), functions.end(), [](auto& a, auto& b)
+    {
+        return a.first < b.first || (a.first == b.first && a.second > b.second);
+    });
+    Location end = 0;
+    for (auto [pos, size]: functions)
+    {
+        if (pos >= end && pos < slots.size())
+            slots[pos].entry = true;
+        end = std::max<Location>(end, pos + size);
+    }
+    
+    bool changed = true;
+    while (changed)
+    {
+        changed = remove_push_pop(slots);
+        changed = remove_dead_writes(slots) || changed;
+        changed = remove_reloads(slots) || changed;
+        changed = make_tail_calls(slots) || changed;
+    }
+    
+    // new_pos[i] is where the byte at i (or the next kept one) ends up.
+    vector<Location> new_pos(slots.size() + 1);
+    code.clear();
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        new_pos[i] = static_cast<Location>(code.size());
+        if (!slots[i].removed)
+            code.push_back(slots[i].byte);
+    }
+    new_pos[slots.size()] = static_cast<Location>(code.size());
+    
+    for (auto& [name, sym]: unit.symbols)
+    {
+        for (auto& ref: sym.references_in_code)
+            ref.pos = new_pos.at(ref.pos);
+        if (sym.type != Sym_type::code || sym.is_external())
+            continue;
+        Location start = new_pos.at(sym.pos);
+        for (auto& [other, refs]: sym.references_to_others)
+            for (auto& ref: refs)
+                ref.pos = new_pos.at(sym.pos + ref.pos) - start;
+        sym.size = new_pos.at(sym.pos + sym.size) - start;
+        sym.pos = start;
+    }
+}
@@ -0,0 +1,735 @@
+// registers.cpp
+// Register allocation for Visy
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "registers.hpp"
+
+#include <algorithm>
+
+namespace fauces
+{
+
+constexpr std::uint32_t no_slot = UINT32_MAX;
+constexpr std::uint32_t never = UINT32_MAX;
+
+static inline unsigned number(Phys_reg reg)
+{
+    return static_cast<unsigned>(reg);
+}
+
+static inline Phys_reg other_r(Phys_reg reg)
+{
+    return reg == Phys_reg::r0 ? Phys_reg::r1 : Phys_reg::r0;
+}
+
+// X register that goes with an R register for addressing, and vice versa
+static inline Phys_reg partner(Phys_reg reg)
+{
+    return static_cast<Phys_reg>(number(reg) ^ 2);
+}
+
+static bool is_r(Phys_reg reg)
+{
+    return reg == Phys_reg::r0 || reg == Phys_reg::r1;
+}
+
+// Weight of a use at a loop depth: values used in inner loops are much more
+// expensive to keep out of registers.
+static std::uint64_t weight(unsigned depth)
+{
+    return std::uint64_t {1} << (3 * std::min(depth, 10u));
+}
+
+struct Use
+{
+    std::uint32_t pos;
+    std::uint64_t weight;
+};
+
+class Register_allocator
+{
+public:
+    Register_allocator(const std::vector<Alloc_block>& blocks, Vreg count);
+    
+    Allocation run();
+private:
+    struct Location
+    {
+        Vreg reg;
+        Phys_reg where;
+        bool clean;
+    };
+    
+    const std::vector<Alloc_block>& blocks;
+    Vreg count;
+    std::vector<std::vector<bool>> live_in;
+    std::vector<std::vector<bool>> live_out;
+    std::vector<std::vector<std::uint32_t>> loops;  // Headers around a block
+    std::vector<unsigned> depth;
+    std::vector<std::uint32_t> first_pos;           // Of each block
+    std::vector<std::vector<Use>> uses;             // Of each vreg
+    std::vector<std::vector<std::uint64_t>> remaining; // Suffix sums of uses
+    std::vector<Vreg> index_base;       // Base first added to an X vreg
+    
+    // State of the walk
+    std::array<Vreg, 4> occupant;
+    std::vector<Phys_reg> where;
+    std::vector<bool> clean;            // The slot has the current value
+    std::vector<std::uint32_t> slot;
+    std::vector<std::uint32_t> next_use;
+    std::uint32_t pos = 0;
+    std::uint32_t block = 0;
+    unsigned locked = 0;                // Registers needed by the instruction
+    Allocation result;
+    std::vector<Fixup>* fixups = nullptr;
+    std::uint32_t before = 0;
+    
+    void find_loops();
+    void find_liveness();
+    void find_uses();
+    
+    void add_fixup(Fixup_kind kind, Phys_reg reg, Phys_reg other = Phys_reg::none,
+                                                    std::uint32_t slot = 0);
+    std::uint32_t slot_of(Vreg v);
+    std::uint64_t cost(Vreg v);
+    void assign(Vreg v, Phys_reg reg);
+    void release(Phys_reg reg);
+    void evict(Phys_reg reg);
+    void swap_r();
+    Phys_reg choose(Reg_class cls, Phys_reg preferred, bool insist = false);
+    void load(Vreg v, Phys_reg fixed, Phys_reg preferred);
+    void allocate(const Alloc_instruction& ins,
+                                const std::vector<bool>& live_after);
+    void start_block(std::uint32_t b);
+    std::vector<Location> locations(const std::vector<bool>& live) const;
+    void resolve(std::uint32_t from, std::uint32_t to,
+                        const std::vector<Location>& end,
+                        const std::vector<Location>& start);
+};
+
+Register_allocator::Register_allocator(const std::vector<Alloc_block>& blocks,
+                                                                Vreg count):
+blocks {blocks}, count {count}
+{
+    where.assign(count, Phys_reg::none);
+    clean.assign(count, false);
+    slot.assign(count, no_slot);
+    next_use.assign(count, 0);
+    index_base.assign(count, no_vreg);
+    occupant.fill(no_vreg);
+    find_loops();
+    find_liveness();
+    find_uses();
+}
+
+// Natural loops of back edges found depth first, which is exact for the
+// reducible graphs we generate.
+void Register_allocator::find_loops()
+{
+    auto n = blocks.size();
+    loops.assign(n, {});
+    depth.assign(n, 0);
+    std::vector<std::vector<std::uint32_t>> predecessors(n);
+    for (std::uint32_t b = 0; b < n; ++b)
+    {
+        for (auto s: blocks[b].successors)
+            predecessors[s].push_back(b);
+    }
+    enum {unseen, open, closed};
+    std::vector<int> state(n, unseen);
+    std::vector<std::pair<std::uint32_t, size_t>> stack;
+    if (n)
+    {
+        stack.push_back({0, 0});
+        state[0] = open;
+    }
+    while (!stack.empty())
+    {
+        auto& [b, next] = stack.back();
+        if (next == blocks[b].successors.size())
+        {
+            state[b] = closed;
+            stack.pop_back();
+            continue;
+        }
+        auto s = blocks[b].successors[next++];
+        if (state[s] == unseen)
+        {
+            state[s] = open;
+            stack.push_back({s, 0});
+        }
+        else if (state[s] == open)
+        {
+            // Back edge from b to header s
+            std::vector<bool> body(n);
+            std::vector<std::uint32_t> work {b};
+            body[s] = true;
+            while (!work.empty())
+            {
+                auto w = work.back();
+                work.pop_back();
+                if (body[w])
+                    continue;
+                body[w] = true;
+                for (auto p: predecessors[w])
+                    work.push_back(p);
+            }
+            for (std::uint32_t m = 0; m < n; ++m)
+            {
+                if (body[m] && std::find(loops[m].begin(), loops[m].end(), s)
+                                                            == loops[m].end())
+                {
+                    loops[m].push_back(s);
+                    ++depth[m];
+                }
+            }
+        }
+    }
+}
+
+void Register_allocator::find_liveness()
+{
+    auto n = blocks.size();
+    std::vector<std::vector<bool>> used(n, std::vector<bool>(count));
+    std::vector<std::vector<bool>> defined(n, std::vector<bool>(count));
+    for (std::uint32_t b = 0; b < n; ++b)
+    {
+        for (auto& ins: blocks[b].code)
+        {
+            for (auto& op: ins.operands)
+            {
+                if (op.reg != no_vreg && op.read && !defined[b][op.reg])
+                    used[b][op.reg] = true;
+            }
+            for (auto& op: ins.operands)
+            {
+                if (op.reg != no_vreg && op.write)
+                    defined[b][op.reg] = true;
+            }
+        }
+    }
+    live_in.assign(n, std::vector<bool>(count));
+    live_out.assign(n, std::vector<bool>(count));
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto b = n; b-- > 0;)
+        {
+            auto& out = live_out[b];
+            for (auto s: blocks[b].successors)
+            {
+                for (Vreg v = 0; v < count; ++v)
+                {
+                    if (live_in[s][v] && !out[v])
+                        out[v] = changed = true;
+                }
+            }
+            for (Vreg v = 0; v < count; ++v)
+            {
+                bool in = used[b][v] || (out[v] && !defined[b][v]);
+                if (in && !live_in[b][v])
+                    live_in[b][v] = changed = true;
+            }
+        }
+    }
+}
+
+void Register_allocator::find_uses()
+{
+    uses.assign(count, {});
+    first_pos.clear();
+    std::uint32_t p = 0;
+    for (std::uint32_t b = 0; b < blocks.size(); ++b)
+    {
+        first_pos.push_back(p);
+        for (auto& ins: blocks[b].code)
+        {
+            for (auto& op: ins.operands)
+            {
+                if (op.reg != no_vreg && op.read)
+                    uses[op.reg].push_back({p, weight(depth[b])});
+            }
+            if (ins.base >= 0)
+            {
+                auto x = ins.operands[2].reg;
+                if (x != no_vreg && index_base[x] == no_vreg)
+                    index_base[x] = ins.operands[ins.base].reg;
+            }
+            ++p;
+        }
+    }
+    remaining.assign(count, {});
+    for (Vreg v = 0; v < count; ++v)
+    {
+        auto& r = remaining[v];
+        r.assign(uses[v].size() + 1, 0);
+        for (auto i = uses[v].size(); i-- > 0;)
+            r[i] = r[i + 1] + uses[v][i].weight;
+    }
+}
+
+void Register_allocator::add_fixup(Fixup_kind kind, Phys_reg reg,
+                                        Phys_reg other, std::uint32_t slot)
+{
+    fixups->push_back({kind, reg, other, slot, before});
+    switch (kind)
+    {
+        case Fixup_kind::spill:
+            ++result.spills;
+            break;
+        case Fixup_kind::reload:
+            ++result.reloads;
+            break;
+        default:
+            ++result.moves;
+    }
+}
+
+std::uint32_t Register_allocator::slot_of(Vreg v)
+{
+    if (slot[v] == no_slot)
+        slot[v] = result.slots++;
+    return slot[v];
+}
+
+// What it would cost to keep v out of registers from now on
+std::uint64_t Register_allocator::cost(Vreg v)
+{
+    auto& u = uses[v];
+    auto& i = next_use[v];
+    while (i < u.size() && u[i].pos < pos)
+        ++i;
+    auto c = remaining[v][i];
+    for (auto h: loops[block])
+    {
+        // Carried around the loop: used again on the next iteration.
+        if (live_in[h][v])
+            c += weight(depth[h]);
+    }
+    return c;
+}
+
+void Register_allocator::assign(Vreg v, Phys_reg reg)
+{
+    occupant[number(reg)] = v;
+    where[v] = reg;
+}
+
+void Register_allocator::release(Phys_reg reg)
+{
+    auto v = occupant[number(reg)];
+    if (v != no_vreg)
+        where[v] = Phys_reg::none;
+    occupant[number(reg)] = no_vreg;
+}
+
+// Makes a register available, saving its value if still needed
+void Register_allocator::evict(Phys_reg reg)
+{
+    auto v = occupant[number(reg)];
+    if (v == no_vreg)
+        return;
+    if (!is_r(reg))
+        throw Limit_error {"Too many index values alive at once"};
+    if (!clean[v])
+    {
+        add_fixup(Fixup_kind::spill, reg, Phys_reg::none, slot_of(v));
+        clean[v] = true;
+    }
+    release(reg);
+}
+
+void Register_allocator::swap_r()
+{
+    add_fixup(Fixup_kind::swap, Phys_reg::r0, Phys_reg::r1);
+    std::swap(occupant[0], occupant[1]);
+    for (unsigned r = 0; r < 2; ++r)
+    {
+        if (occupant[r] != no_vreg)
+            where[occupant[r]] = static_cast<Phys_reg>(r);
+    }
+}
+
+// Finds a register for a new value, evicting the cheapest one if needed.
+// Insisting on the preferred register evicts whatever it holds.
+Phys_reg Register_allocator::choose(Reg_class cls, Phys_reg preferred,
+                                                                bool insist)
+{
+    unsigned first = cls == Reg_class::r ? 0 : 2;
+    auto available = [&](unsigned r)
+    {
+        return occupant[r] == no_vreg && !(locked & (1u << r));
+    };
+    if (preferred != Phys_reg::none && available(number(preferred)))
+        return preferred;
+    if (insist && preferred != Phys_reg::none &&
+                                        !(locked & (1u << number(preferred))))
+    {
+        evict(preferred);
+        return preferred;
+    }
+    for (unsigned r = first; r < first + 2; ++r)
+    {
+        if (available(r))
+            return static_cast<Phys_reg>(r);
+    }
+    Phys_reg victim = Phys_reg::none;
+    std::uint64_t lowest = 0;
+    for (unsigned r = first; r < first + 2; ++r)
+    {
+        if (locked & (1u << r))
+            continue;
+        auto c = cost(occupant[r]);
+        if (victim == Phys_reg::none || c < lowest)
+        {
+            victim = static_cast<Phys_reg>(r);
+            lowest = c;
+        }
+    }
+    if (victim == Phys_reg::none)
+        throw Limit_error {"Too many registers needed by an instruction"};
+    evict(victim);
+    return victim;
+}
+
+// Brings v into a register before it is read.
+void Register_allocator::load(Vreg v, Phys_reg fixed, Phys_reg preferred)
+{
+    auto current = where[v];
+    if (current != Phys_reg::none)
+    {
+        if (fixed == Phys_reg::none || fixed == current)
+            return;
+        if (occupant[number(fixed)] == no_vreg)
+        {
+            add_fixup(Fixup_kind::move, current, fixed);
+            release(current);
+            assign(v, fixed);
+        }
+        else
+            swap_r();
+        return;
+    }
+    if (slot[v] == no_slot)
+        throw Limit_error {"Value used before it is defined"};
+    auto reg = fixed;
+    if (reg == Phys_reg::none)
+        // A spill and a reload are cheaper than exchanging R0 and R1.
+        reg = choose(Reg_class::r, preferred, true);
+    else
+        evict(reg);
+    add_fixup(Fixup_kind::reload, reg, Phys_reg::none, slot[v]);
+    assign(v, reg);
+    clean[v] = true;
+}
+
+void Register_allocator::allocate(const Alloc_instruction& ins,
+                                            const std::vector<bool>& live_after)
+{
+    auto& ops = ins.operands;
+    locked = 0;
+    
+    // Reads: fixed registers first, so that they do not move the others.
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            auto& op = ops[i];
+            if (op.reg == no_vreg || !op.read ||
+                                    (op.fixed == Phys_reg::none) == (pass == 0))
+                continue;
+            if (op.cls == Reg_class::x)
+            {
+                if (!(where[op.reg] == Phys_reg::x0 ||
+                                            where[op.reg] == Phys_reg::x1))
+                    throw Limit_error {"Index value not in an index register"};
+            }
+            else
+            {
+                auto preferred = Phys_reg::none;
+                if (i == ins.base && ops[2].reg != no_vreg &&
+                                            where[ops[2].reg] != Phys_reg::none)
+                    preferred = partner(where[ops[2].reg]);
+                load(op.reg, op.fixed, preferred);
+            }
+            locked |= 1u << number(where[op.reg]);
+        }
+    }
+    
+    // Xn is added to Rn: exchange R0 and R1 if they are the wrong way.
+    bool swapped = false;
+    if (ins.base >= 0 && ops[2].reg != no_vreg)
+    {
+        auto base = where[ops[ins.base].reg];
+        if (base != partner(where[ops[2].reg]))
+        {
+            swap_r();
+            swapped = true;
+        }
+    }
+    
+    std::array<Phys_reg, 3> regs;
+    for (int i = 0; i < 3; ++i)
+        regs[i] = ops[i].read ? where[ops[i].reg] : Phys_reg::none;
+    
+    // Values destroyed by the instruction that are still needed later
+    for (unsigned r = 0; r < 4; ++r)
+    {
+        auto v = occupant[r];
+        if (!(ins.clobbers & (1u << r)) || v == no_vreg)
+            continue;
+        if (live_after[v])
+            evict(static_cast<Phys_reg>(r));
+        else
+            release(static_cast<Phys_reg>(r));
+    }
+    
+    // Operands read for the last time free their registers, unless written.
+    auto written = [&](Vreg v)
+    {
+        for (auto& op: ops)
+        {
+            if (op.reg == v && op.write)
+                return true;
+        }
+        return false;
+    };
+    for (auto& op: ops)
+    {
+        if (op.reg != no_vreg && op.read && !written(op.reg) &&
+                    !live_after[op.reg] && where[op.reg] != Phys_reg::none)
+            release(where[op.reg]);
+    }
+    
+    locked = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        auto& op = ops[i];
+        if (op.reg == no_vreg || !op.write)
+            continue;
+        auto current = where[op.reg];
+        if (current != Phys_reg::none &&
+                            (op.fixed == Phys_reg::none || op.fixed == current))
+        {
+            // Modified in place, or an old value is replaced.
+            clean[op.reg] = false;
+            locked |= 1u << number(current);
+            regs[i] = current;
+            continue;
+        }
+        if (current != Phys_reg::none)
+            release(current);
+        Phys_reg reg = op.fixed;
+        if (reg != Phys_reg::none)
+            evict(reg);
+        else if (op.cls == Reg_class::x)
+        {
+            auto base = index_base[op.reg];
+            auto preferred = base != no_vreg && where[base] != Phys_reg::none ?
+                                        partner(where[base]) : Phys_reg::none;
+            reg = choose(Reg_class::x, preferred);
+        }
+        else
+        {
+            auto preferred = Phys_reg::none;
+            if (ins.is_copy && i == 1 && regs[0] != Phys_reg::none &&
+                                occupant[number(regs[0])] == no_vreg)
+            {
+                preferred = regs[0];
+                ++result.coalesced;
+            }
+            reg = choose(Reg_class::r, preferred);
+        }
+        assign(op.reg, reg);
+        clean[op.reg] = false;
+        locked |= 1u << number(reg);
+        regs[i] = reg;
+    }
+    locked = 0;
+    
+    fixups = &result.blocks[block].fixups;
+    ++before;
+    for (auto& op: ops)
+    {
+        // Values written but never read
+        if (op.reg != no_vreg && op.write && !live_after[op.reg] &&
+                                            where[op.reg] != Phys_reg::none)
+            release(where[op.reg]);
+    }
+    result.blocks[block].operands.push_back(regs);
+    if (swapped)
+        swap_r();
+}
+
+// Values kept from the previous block in order, and where they start
+void Register_allocator::start_block(std::uint32_t b)
+{
+    block = b;
+    before = 0;
+    fixups = &result.blocks[b].fixups;
+    for (unsigned r = 0; r < 4; ++r)
+    {
+        auto v = occupant[r];
+        if (v != no_vreg && !live_in[b][v])
+            release(static_cast<Phys_reg>(r));
+    }
+    for (Vreg v = 0; v < count; ++v)
+    {
+        if (!live_in[b][v])
+            continue;
+        if (where[v] == Phys_reg::none)
+            slot_of(v);
+        else if (!is_r(where[v]))
+            continue;
+        // Other paths into the block may not have saved it.
+        clean[v] = false;
+    }
+}
+
+auto Register_allocator::locations(const std::vector<bool>& live) const
+-> std::vector<Location>
+{
+    std::vector<Location> l;
+    for (Vreg v = 0; v < count; ++v)
+    {
+        if (live[v])
+            l.push_back({v, where[v], clean[v]});
+    }
+    return l;
+}
+
+void Register_allocator::resolve(std::uint32_t from, std::uint32_t to,
+                                        const std::vector<Location>& end,
+                                        const std::vector<Location>& start)
+{
+    Edge_allocation edge {from, to, {}};
+    fixups = &edge.fixups;
+    before = 0;
+    std::vector<std::pair<Location, Location>> changes;
+    for (auto& s: start)
+    {
+        auto e = std::lower_bound(end.begin(), end.end(), s.reg,
+                    [](const Location& l, Vreg v) {return l.reg < v;});
+        if (e == end.end() || e->reg != s.reg)
+            throw Limit_error {"Value not alive where it is needed"};
+        if (e->where != s.where)
+            changes.push_back({*e, s});
+    }
+    for (auto& [e, s]: changes)
+    {
+        if (!is_r(e.where) && e.where != Phys_reg::none)
+            throw Limit_error {"Index value alive across blocks"};
+        if (s.where == Phys_reg::none && !e.clean)
+            add_fixup(Fixup_kind::spill, e.where, Phys_reg::none, slot[e.reg]);
+    }
+    size_t between = 0;
+    Phys_reg move_from = Phys_reg::none;
+    Phys_reg move_to = Phys_reg::none;
+    for (auto& [e, s]: changes)
+    {
+        if (e.where != Phys_reg::none && s.where != Phys_reg::none)
+        {
+            ++between;
+            move_from = e.where;
+            move_to = s.where;
+        }
+    }
+    if (between == 2)
+        add_fixup(Fixup_kind::swap, Phys_reg::r0, Phys_reg::r1);
+    else if (between == 1)
+        add_fixup(Fixup_kind::move, move_from, move_to);
+    for (auto& [e, s]: changes)
+    {
+        if (e.where == Phys_reg::none)
+            add_fixup(Fixup_kind::reload, s.where, Phys_reg::none, slot[s.reg]);
+    }
+    if (!edge.fixups.empty())
+        result.edges.push_back(std::move(edge));
+}
+
+Allocation Register_allocator::run()
+{
+    auto n = static_cast<std::uint32_t>(blocks.size());
+    result.blocks.resize(n);
+    std::vector<std::vector<Location>> starts(n);
+    std::vector<std::vector<Location>> ends(n);
+    for (std::uint32_t b = 0; b < n; ++b)
+    {
+        start_block(b);
+        starts[b] = locations(live_in[b]);
+        
+        // Liveness after every instruction, backwards from the block end
+        auto& code = blocks[b].code;
+        std::vector<std::vector<bool>> live_after(code.size());
+        auto live = live_out[b];
+        for (auto i = code.size(); i-- > 0;)
+        {
+            live_after[i] = live;
+            for (auto& op: code[i].operands)
+            {
+                if (op.reg != no_vreg && op.write && !op.read)
+                    live[op.reg] = false;
+            }
+            for (auto& op: code[i].operands)
+            {
+                if (op.reg != no_vreg && op.read)
+                    live[op.reg] = true;
+            }
+        }
+        
+        pos = first_pos[b];
+        for (size_t i = 0; i < code.size(); ++i, ++pos)
+            allocate(code[i], live_after[i]);
+        for (Vreg v = 0; v < count; ++v)
+        {
+            if (live_out[b][v] && where[v] == Phys_reg::none)
+                slot_of(v);
+        }
+        ends[b] = locations(live_out[b]);
+    }
+    for (std::uint32_t b = 0; b < n; ++b)
+    {
+        auto& successors = blocks[b].successors;
+        for (auto s = successors.begin(); s != successors.end(); ++s)
+        {
+            // Both ways of a branch may lead to the same block.
+            if (std::find(successors.begin(), s, *s) == s)
+                resolve(b, *s, ends[b], starts[*s]);
+        }
+    }
+    return std::move(result);
+}
+
+} // namespace fauces
+
+auto fauces::allocate_registers(const std::vector<Alloc_block>& blocks,
+                                                    Vreg count) -> Allocation
+{
+    return Register_allocator {blocks, count}.run();
+}
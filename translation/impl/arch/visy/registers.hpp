@@ -0,0 +1,155 @@
+// registers.hpp
+// Register allocation for Visy
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef arch_visy_registers_hpp
+#define arch_visy_registers_hpp
+
+#include "pieces.hpp"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+// Visy only has two general purpose registers (R0 and R1) and two index
+// registers (X0 and X1), while S0 and S1 hold the stack. Code is generated
+// with any number of virtual registers, which this allocator maps to the
+// physical ones, keeping in the frame (spilling) whatever does not fit.
+//
+// The allocator follows the linear scan family: it walks the code once in
+// block order, keeping values in registers until they die or a register is
+// needed for something more valuable. The value evicted is the one whose
+// remaining uses are cheapest, and uses inside loops weigh much more, so
+// loop-carried values tend to stay in registers. Where the location of a
+// value at the end of a block differs from its location where a successor
+// starts, fix-ups are returned for that edge.
+//
+// Index registers cannot be read or saved: they are only loaded from an R
+// register and added to an R register for addressing, where Xn always goes
+// with Rn. The allocator chooses the X register that matches the base; when
+// that is not possible, R0 and R1 are exchanged around the instruction.
+
+namespace fauces
+{
+
+using Vreg = std::uint32_t;
+constexpr Vreg no_vreg = UINT32_MAX;
+
+enum class Reg_class: std::uint8_t
+{
+    r,
+    x
+};
+
+// Registers that may be allocated, also used as bit numbers in masks.
+enum class Phys_reg: std::uint8_t
+{
+    r0, r1, x0, x1, none
+};
+
+struct Alloc_operand
+{
+    Vreg reg = no_vreg;
+    Reg_class cls = Reg_class::r;
+    bool read = false;
+    bool write = false;
+    Phys_reg fixed = Phys_reg::none;
+};
+
+// What the allocator needs to know about an instruction. Operands 0 and 1
+// are the registers in the source and destination fields; operand 2 is the
+// index register implicitly added to the base operand.
+struct Alloc_instruction
+{
+    std::array<Alloc_operand, 3> operands;
+    std::int8_t base = -1;
+    bool is_copy = false;           // lrr
+    std::uint8_t clobbers = 0;      // Mask of Phys_reg destroyed (calls)
+};
+
+struct Alloc_block
+{
+    std::vector<Alloc_instruction> code;
+    std::vector<std::uint32_t> successors;
+};
+
+enum class Fixup_kind: std::uint8_t
+{
+    spill,      // Store reg into slot
+    reload,     // Load reg from slot
+    move,       // Copy reg into other
+    swap        // Exchange R0 and R1
+};
+
+struct Fixup
+{
+    Fixup_kind kind;
+    Phys_reg reg = Phys_reg::none;
+    Phys_reg other = Phys_reg::none;
+    std::uint32_t slot = 0;
+    std::uint32_t before = 0;   // Instruction number in its block
+};
+
+struct Block_allocation
+{
+    std::vector<std::array<Phys_reg, 3>> operands;  // For every instruction
+    std::vector<Fixup> fixups;                      // In order
+};
+
+// Fix-ups for a control flow edge belong at the end of the first block if
+// it has no other successor, at the start of the second one if it has no
+// other predecessor, or else into a new block in between.
+struct Edge_allocation
+{
+    std::uint32_t from;
+    std::uint32_t to;
+    std::vector<Fixup> fixups;
+};
+
+struct Allocation
+{
+    std::vector<Block_allocation> blocks;
+    std::vector<Edge_allocation> edges;
+    std::uint32_t slots = 0;    // Spill slots needed in the frame
+    
+    // Counts to compare the quality of allocations
+    size_t spills = 0;
+    size_t reloads = 0;
+    size_t moves = 0;
+    size_t coalesced = 0;       // Copies that need no instruction
+};
+
+// Block 0 is the entry. There must be no more than two index values alive
+// at the same time and none across a call, which the code generator can
+// easily ensure by loading them right before they are needed.
+Allocation allocate_registers(const std::vector<Alloc_block>& blocks,
+                                                                Vreg count);
+
+} // namespace fauces
+
+#endif /* arch_visy_registers_hpp */
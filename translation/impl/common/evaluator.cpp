@@ -0,0 +1,856 @@
+// evaluator.cpp
+// Evaluation of constant expressions
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "evaluator.hpp"
+
+#include <climits>
+
+namespace fauces
+{
+
+// Values are kept as 64 bits integers in the range of their type, so this
+// can never be the value of a variable.
+constexpr std::int64_t uninitialized = INT64_MIN;
+
+[[noreturn]] static void fail(const Ast& ast, Node_id where,
+                                                            const string& msg)
+{
+    throw Syntax_error {ast.location(where) + msg};
+}
+
+static Int_type int_type(unsigned bits, bool is_unsigned)
+{
+    return {static_cast<std::uint8_t>(bits), is_unsigned};
+}
+
+static std::int64_t wrap(std::int64_t value, Int_type type)
+{
+    std::uint64_t mask = (std::uint64_t {1} << type.bits) - 1;
+    std::uint64_t v = static_cast<std::uint64_t>(value) & mask;
+    if (!type.is_unsigned && (v >> (type.bits - 1)) != 0)
+        v |= ~mask;
+    return static_cast<std::int64_t>(v);
+}
+
+static std::int64_t arithmetic(const Ast& ast, const Instruction& i,
+                                                std::int64_t a, std::int64_t b)
+{
+    std::int64_t r = 0;
+    switch (i.op)
+    {
+        case Bytecode::add:
+            r = a + b;
+            break;
+        case Bytecode::sub:
+        case Bytecode::neg:
+            r = a - b;
+            break;
+        case Bytecode::mul:
+            // Unsigned products may not fit, but they wrap anyway.
+            r = static_cast<std::int64_t>(static_cast<std::uint64_t>(a) *
+                                            static_cast<std::uint64_t>(b));
+            break;
+        case Bytecode::div:
+        case Bytecode::rem:
+            if (b == 0)
+                fail(ast, i.node, "Division by zero");
+            if (!i.type.is_unsigned && wrap(a / b, i.type) != a / b)
+                fail(ast, i.node, "Overflow in constant expression");
+            r = i.op == Bytecode::div ? a / b : a % b;
+            break;
+        case Bytecode::shl:
+        case Bytecode::shr:
+            if (b < 0 || b >= i.type.bits)
+                fail(ast, i.node, "Shift by a bad amount");
+            if (i.op == Bytecode::shr)
+                return a >> b;
+            return wrap(static_cast<std::int64_t>(
+                                static_cast<std::uint64_t>(a) << b), i.type);
+        case Bytecode::bit_and:
+            return a & b;
+        case Bytecode::bit_or:
+            return a | b;
+        case Bytecode::bit_xor:
+            return a ^ b;
+        case Bytecode::lt:
+            return a < b;
+        case Bytecode::gt:
+            return a > b;
+        case Bytecode::le:
+            return a <= b;
+        case Bytecode::ge:
+            return a >= b;
+        case Bytecode::eq:
+            return a == b;
+        case Bytecode::ne:
+            return a != b;
+        default:
+            break;
+    }
+    if (i.type.is_unsigned)
+        return wrap(r, i.type);
+    if (wrap(r, i.type) != r)
+        fail(ast, i.node, "Overflow in constant expression");
+    return r;
+}
+
+static const std::pair<Op, Bytecode> binary_codes[]
+{
+    {Op::add, Bytecode::add}, {Op::sub, Bytecode::sub},
+    {Op::mul, Bytecode::mul}, {Op::div, Bytecode::div},
+    {Op::rem, Bytecode::rem}, {Op::shl, Bytecode::shl},
+    {Op::shr, Bytecode::shr}, {Op::bit_and, Bytecode::bit_and},
+    {Op::bit_or, Bytecode::bit_or}, {Op::bit_xor, Bytecode::bit_xor},
+    {Op::lt, Bytecode::lt}, {Op::gt, Bytecode::gt}, {Op::le, Bytecode::le},
+    {Op::ge, Bytecode::ge}, {Op::eq, Bytecode::eq}, {Op::ne, Bytecode::ne}
+};
+
+// Translates the body of a function, or a single expression, into bytecode.
+// Operands of binary operators are converted after both have been computed,
+// so that the type of the right one is known when the left one is converted.
+class Function_compiler
+{
+public:
+    Function_compiler(Constant_evaluator& evaluator,
+                                            std::vector<Instruction>& code):
+    evaluator {evaluator}, ast {evaluator.ast}, code {code}
+    {}
+    
+    size_t locals() const
+    {
+        return slots;
+    }
+    
+    void parameter(std::uint32_t name, Int_type type);
+    void function_body(Node_id body, Int_type result);
+    void returned_expression(Node_id e);
+private:
+    struct Local
+    {
+        std::uint32_t name;
+        std::uint32_t slot;
+        Int_type type;
+        bool is_const;
+    };
+    
+    Constant_evaluator& evaluator;
+    const Ast& ast;
+    std::vector<Instruction>& code;
+    std::vector<Local> scope;
+    std::uint32_t slots = 0;
+    Int_type result;
+    
+    [[noreturn]] void error(Node_id where, const string& msg) const
+    {
+        fail(ast, where, msg);
+    }
+    
+    size_t emit(Bytecode op, Int_type type, std::int64_t operand,
+                                                                Node_id where);
+    void patch(size_t jump)
+    {
+        code[jump].operand = static_cast<std::int64_t>(code.size());
+    }
+    
+    Int_type int_type() const
+    {
+        return fauces::int_type(evaluator.model.int_bits, false);
+    }
+    
+    const Local* local(std::uint32_t name) const;
+    Int_type promote(Int_type type) const;
+    Int_type common(Int_type a, Int_type b) const;
+    void convert(Int_type from, Int_type to, Node_id where, int depth = 0);
+    
+    void statement(Node_id s);
+    void variable(Node_id v);
+    Int_type expression(Node_id e);
+    Int_type value(Node_id e);
+    Int_type integer(Node_id e);
+    Int_type name(Node_id e);
+    Int_type unary(Node_id e);
+    Int_type binary(Node_id e);
+    Int_type logical(Node_id e);
+    Int_type assignment(Node_id e);
+    Int_type call(Node_id e);
+};
+
+size_t Function_compiler::emit(Bytecode op, Int_type type,
+                                        std::int64_t operand, Node_id where)
+{
+    Instruction i;
+    i.op = op;
+    i.type = type;
+    i.node = where;
+    i.operand = operand;
+    code.push_back(i);
+    return code.size() - 1;
+}
+
+auto Function_compiler::local(std::uint32_t name) const -> const Local*
+{
+    for (auto l = scope.rbegin(); l != scope.rend(); ++l)
+    {
+        if (l->name == name)
+            return &*l;
+    }
+    return nullptr;
+}
+
+Int_type Function_compiler::promote(Int_type type) const
+{
+    return type.bits < evaluator.model.int_bits ? int_type() : type;
+}
+
+Int_type Function_compiler::common(Int_type a, Int_type b) const
+{
+    a = promote(a);
+    b = promote(b);
+    if (a == b)
+        return a;
+    if (a.bits != b.bits)
+        return a.bits > b.bits ? a : b;
+    return fauces::int_type(a.bits, true);
+}
+
+void Function_compiler::convert(Int_type from, Int_type to, Node_id where,
+                                                                    int depth)
+{
+    if (!(from == to))
+        emit(Bytecode::convert, to, depth, where);
+}
+
+void Function_compiler::parameter(std::uint32_t name, Int_type type)
+{
+    scope.push_back({name, slots++, type, false});
+}
+
+void Function_compiler::function_body(Node_id body, Int_type result)
+{
+    this->result = result;
+    statement(body);
+    emit(result.bits ? Bytecode::fail : Bytecode::ret_void, result, 0, body);
+}
+
+void Function_compiler::returned_expression(Node_id e)
+{
+    result = value(e);
+    emit(Bytecode::ret, result, 0, e);
+}
+
+void Function_compiler::statement(Node_id s)
+{
+    auto& node = ast[s];
+    switch (node.kind)
+    {
+        case Node_kind::compound:
+        {
+            auto mark = scope.size();
+            for (Node_id c = node.first; c != no_node; c = ast[c].next)
+                statement(c);
+            scope.resize(mark);
+            break;
+        }
+        case Node_kind::return_statement:
+            if (node.first == no_node)
+            {
+                if (result.bits)
+                    error(s, "Return without a value");
+                emit(Bytecode::ret_void, result, 0, s);
+            }
+            else
+            {
+                if (!result.bits)
+                    error(s, "Return of a value from a void function");
+                convert(value(node.first), result, s);
+                emit(Bytecode::ret, result, 0, s);
+            }
+            break;
+        case Node_kind::if_statement:
+        {
+            Node_id condition = node.first;
+            Node_id then = ast[condition].next;
+            Node_id otherwise = ast[then].next;
+            value(condition);
+            auto skip = emit(Bytecode::jump_if_zero, {}, 0, s);
+            auto mark = scope.size();
+            statement(then);
+            scope.resize(mark);
+            if (otherwise != no_node)
+            {
+                auto end = emit(Bytecode::jump, {}, 0, s);
+                patch(skip);
+                statement(otherwise);
+                scope.resize(mark);
+                skip = end;
+            }
+            patch(skip);
+            break;
+        }
+        case Node_kind::expression_statement:
+            if (node.first != no_node && expression(node.first).bits)
+                emit(Bytecode::pop, {}, 0, s);
+            break;
+        case Node_kind::variable:
+            variable(s);
+            break;
+        default:
+            error(s, "Statement not allowed in constant evaluation");
+    }
+}
+
+void Function_compiler::variable(Node_id v)
+{
+    auto& node = ast[v];
+    Node_id type = node.first;
+    Node_id initializer = ast[type].next;
+    Int_type t = evaluator.type_of(type);
+    if (!t.bits)
+        error(v, "Variable of type void");
+    bool is_const = (node.flags & declared_constexpr) ||
+                                                (ast[type].flags & type_const);
+    auto slot = slots++;
+    if (initializer != no_node)
+    {
+        convert(value(initializer), t, v);
+        emit(Bytecode::store, t, slot, v);
+    }
+    else if (is_const)
+        error(v, "Constant without initializer");
+    scope.push_back({node.value, slot, t, is_const});
+}
+
+Int_type Function_compiler::expression(Node_id e)
+{
+    switch (ast[e].kind)
+    {
+        case Node_kind::integer:
+            return integer(e);
+        case Node_kind::name:
+            return name(e);
+        case Node_kind::unary:
+            return unary(e);
+        case Node_kind::binary:
+            return binary(e);
+        case Node_kind::call:
+            return call(e);
+        default:
+            error(e, "Expression not allowed in constant evaluation");
+    }
+}
+
+Int_type Function_compiler::value(Node_id e)
+{
+    Int_type t = expression(e);
+    if (!t.bits)
+        error(e, "Use of a void value");
+    return t;
+}
+
+Int_type Function_compiler::integer(Node_id e)
+{
+    // Without long types, octal and hexadecimal literals that do not fit into
+    // int are unsigned, while decimal ones are too large unless suffixed.
+    auto& node = ast[e];
+    Int_type t = int_type();
+    if ((node.flags & integer_unsigned) || (!(node.flags & integer_decimal) &&
+                                            wrap(node.value, t) != node.value))
+        t.is_unsigned = true;
+    if (wrap(node.value, t) != node.value)
+        error(e, "Integer literal too large");
+    emit(Bytecode::constant, t, node.value, e);
+    return t;
+}
+
+Int_type Function_compiler::name(Node_id e)
+{
+    auto n = ast[e].value;
+    if (auto l = local(n))
+    {
+        emit(Bytecode::load, l->type, l->slot, e);
+        return l->type;
+    }
+    auto& g = evaluator.global(n, e);
+    emit(Bytecode::constant, g.type, g.value, e);
+    return g.type;
+}
+
+Int_type Function_compiler::unary(Node_id e)
+{
+    auto& node = ast[e];
+    Int_type t = value(node.first);
+    switch (node.op)
+    {
+        case Op::pos:
+            convert(t, promote(t), e);
+            return promote(t);
+        case Op::neg:
+            convert(t, promote(t), e);
+            emit(Bytecode::neg, promote(t), 0, e);
+            return promote(t);
+        case Op::bit_not:
+            convert(t, promote(t), e);
+            emit(Bytecode::bit_not, promote(t), 0, e);
+            return promote(t);
+        case Op::log_not:
+            emit(Bytecode::log_not, int_type(), 0, e);
+            return int_type();
+        default:
+            error(e, "Pointers are not supported in constant evaluation");
+    }
+}
+
+Int_type Function_compiler::binary(Node_id e)
+{
+    auto& node = ast[e];
+    if (node.op == Op::assign)
+        return assignment(e);
+    if (node.op == Op::log_and || node.op == Op::log_or)
+        return logical(e);
+    Int_type left = value(node.first);
+    Int_type right = value(ast[node.first].next);
+    Int_type t;
+    if (node.op == Op::shl || node.op == Op::shr)
+    {
+        // The type of the right operand does not matter.
+        t = promote(left);
+        convert(left, t, e, 1);
+    }
+    else
+    {
+        t = common(left, right);
+        convert(left, t, e, 1);
+        convert(right, t, e);
+    }
+    Bytecode op = Bytecode::fail;
+    for (auto [from, to]: binary_codes)
+    {
+        if (from == node.op)
+            op = to;
+    }
+    emit(op, t, 0, e);
+    return op >= Bytecode::lt && op <= Bytecode::ne ? int_type() : t;
+}
+
+Int_type Function_compiler::logical(Node_id e)
+{
+    auto& node = ast[e];
+    auto shortcut = node.op == Op::log_and ? Bytecode::jump_if_zero :
+                                                    Bytecode::jump_if_not_zero;
+    value(node.first);
+    auto first = emit(shortcut, {}, 0, e);
+    value(ast[node.first].next);
+    auto second = emit(shortcut, {}, 0, e);
+    emit(Bytecode::constant, int_type(), node.op == Op::log_and, e);
+    auto end = emit(Bytecode::jump, {}, 0, e);
+    patch(first);
+    patch(second);
+    emit(Bytecode::constant, int_type(), node.op != Op::log_and, e);
+    patch(end);
+    return int_type();
+}
+
+Int_type Function_compiler::assignment(Node_id e)
+{
+    Node_id target = ast[e].first;
+    const Local* l = nullptr;
+    if (ast[target].kind == Node_kind::name)
+        l = local(ast[target].value);
+    if (!l || l->is_const)
+        error(e, "Assignment to something that is not a local variable");
+    convert(value(ast[target].next), l->type, e);
+    emit(Bytecode::dup, {}, 0, e);
+    emit(Bytecode::store, l->type, l->slot, e);
+    return l->type;
+}
+
+Int_type Function_compiler::call(Node_id e)
+{
+    Node_id callee = ast[e].first;
+    if (ast[callee].kind != Node_kind::name || local(ast[callee].value))
+        error(e, "Call to something that is not a function");
+    auto number = evaluator.function_number(ast[callee].value, e);
+    size_t count = 0;
+    for (Node_id a = ast[callee].next; a != no_node; a = ast[a].next)
+    {
+        // Compiling an argument may add functions: no references are kept.
+        auto& parameters = evaluator.functions[number].parameters;
+        if (count == parameters.size())
+            error(e, "Too many arguments");
+        Int_type t = value(a);
+        convert(t, evaluator.functions[number].parameters[count++], e);
+    }
+    if (count != evaluator.functions[number].parameters.size())
+        error(e, "Too few arguments");
+    emit(Bytecode::call, {}, number, e);
+    return evaluator.functions[number].result;
+}
+
+} // namespace fauces
+
+size_t fauces::Constant_evaluator::Call_key_hash::operator()(
+                                                    const Call_key& key) const
+{
+    size_t h = key.function;
+    for (auto a: key.arguments)
+        h = h * 1000003 ^ static_cast<size_t>(a);
+    return h;
+}
+
+fauces::Constant_evaluator::Constant_evaluator(const Ast& ast,
+                                                        Integer_model model):
+ast {ast}, model {model}
+{
+    if (model.int_bits > 32 || model.char_bits > model.int_bits ||
+                                                            model.char_bits == 0)
+        throw Limit_error {"Integer model not supported by constant evaluation"};
+}
+
+auto fauces::Constant_evaluator::evaluate(Node_id expression) -> std::int64_t
+{
+    std::vector<Instruction> code;
+    Function_compiler compiler {*this, code};
+    compiler.returned_expression(expression);
+    Function f;
+    f.node = expression;
+    f.code = std::move(code);
+    f.locals = compiler.locals();
+    f.compiled = true;
+    functions.push_back(std::move(f));
+    auto number = static_cast<std::uint32_t>(functions.size() - 1);
+    auto value = run(number);
+    if (number == functions.size() - 1)
+        functions.pop_back();
+    return value;
+}
+
+auto fauces::Constant_evaluator::type_of(Node_id type) const -> Int_type
+{
+    auto& node = ast[type];
+    if (node.flags & 0xff)
+        fail(ast, type, "Pointers are not supported in constant evaluation");
+    switch (static_cast<Base_type>(node.value))
+    {
+        case Base_type::void_type:
+            return {};
+        case Base_type::char_type:
+            return int_type(model.char_bits, !model.char_is_signed);
+        case Base_type::signed_char:
+            return int_type(model.char_bits, false);
+        case Base_type::unsigned_char:
+            return int_type(model.char_bits, true);
+        case Base_type::int_type:
+            return int_type(model.int_bits, false);
+        case Base_type::unsigned_int:
+            return int_type(model.int_bits, true);
+    }
+    return {};
+}
+
+auto fauces::Constant_evaluator::declaration(Node_kind kind,
+                                        std::uint32_t name) const -> Node_id
+{
+    for (Node_id d = ast[ast.root()].first; d != no_node; d = ast[d].next)
+    {
+        if (ast[d].kind == kind && ast[d].value == name)
+            return d;
+    }
+    return no_node;
+}
+
+auto fauces::Constant_evaluator::function_number(std::uint32_t name,
+                                            Node_id where) -> std::uint32_t
+{
+    auto found = function_numbers.find(name);
+    if (found != function_numbers.end() &&
+                            functions[found->second].declaration < where)
+        return found->second;
+    Node_id first = declaration(Node_kind::function, name);
+    if (first == no_node || first > where)
+        fail(ast, where, "Call to an undeclared function: " +
+                                                    string {ast.name_text(name)});
+    if (!(ast[first].flags & declared_constexpr))
+        fail(ast, where, "Call to a function that is not constexpr: " +
+                                                    string {ast.name_text(name)});
+    Function f;
+    f.node = no_node;
+    f.declaration = first;
+    f.result = type_of(ast[first].first);
+    for (Node_id c = ast[ast[first].first].next; c != no_node; c = ast[c].next)
+    {
+        if (ast[c].kind == Node_kind::parameter)
+            f.parameters.push_back(type_of(ast[c].first));
+    }
+    // The definition, if any, is the declaration with a body.
+    for (Node_id d = first; d != no_node && f.node == no_node; d = ast[d].next)
+    {
+        auto& node = ast[d];
+        if (node.kind != Node_kind::function || node.value != name)
+            continue;
+        for (Node_id c = ast[node.first].next; c != no_node; c = ast[c].next)
+        {
+            if (ast[c].kind != Node_kind::parameter)
+                f.node = d;
+        }
+    }
+    auto number = static_cast<std::uint32_t>(functions.size());
+    functions.push_back(std::move(f));
+    function_numbers.emplace(name, number);
+    return number;
+}
+
+void fauces::Constant_evaluator::compile(std::uint32_t number)
+{
+    Node_id node = functions[number].node;
+    std::vector<Instruction> code;
+    Function_compiler compiler {*this, code};
+    Node_id body = no_node;
+    for (Node_id c = ast[ast[node].first].next; c != no_node; c = ast[c].next)
+    {
+        // Unnamed parameters get a name that cannot be found.
+        if (ast[c].kind == Node_kind::parameter)
+            compiler.parameter(ast[c].value - 1, type_of(ast[c].first));
+        else
+            body = c;
+    }
+    compiler.function_body(body, functions[number].result);
+    auto& f = functions[number];
+    f.code = std::move(code);
+    f.locals = compiler.locals();
+    f.compiled = true;
+}
+
+auto fauces::Constant_evaluator::global(std::uint32_t name, Node_id where)
+-> const Global&
+{
+    auto& g = globals[name];
+    if (g.node == no_node)
+        g.node = declaration(Node_kind::variable, name);
+    if (g.node == no_node || g.node > where)
+        fail(ast, where, "Undeclared name: " + string {ast.name_text(name)});
+    if (g.evaluated)
+        return g;
+    if (g.evaluating)
+        fail(ast, where, "Constant depends on itself: " +
+                                                    string {ast.name_text(name)});
+    auto& node = ast[g.node];
+    Node_id type = node.first;
+    Node_id initializer = ast[type].next;
+    if (initializer == no_node || !((node.flags & declared_constexpr) ||
+                                            (ast[type].flags & type_const)))
+        fail(ast, where, "Not usable in a constant expression: " +
+                                                    string {ast.name_text(name)});
+    g.type = type_of(type);
+    g.evaluating = true;
+    try
+    {
+        g.value = wrap(evaluate(initializer), g.type);
+    }
+    catch (...)
+    {
+        g.evaluating = false;
+        throw;
+    }
+    g.evaluating = false;
+    g.evaluated = true;
+    return g;
+}
+
+auto fauces::Constant_evaluator::run(std::uint32_t number) -> std::int64_t
+{
+    struct Frame
+    {
+        std::uint32_t function;
+        size_t pc;
+        size_t base;        // Of the locals in the stack
+        Call_key key;       // For memoization
+    };
+    
+    std::vector<std::int64_t> stack;
+    std::vector<Frame> frames;
+    auto push = [&](std::int64_t value)
+    {
+        if (stack.size() + frames.size() >= max_stack)
+            throw Limit_error {"Constant evaluation exceeded its memory"};
+        stack.push_back(value);
+    };
+    auto pop = [&]
+    {
+        auto value = stack.back();
+        stack.pop_back();
+        return value;
+    };
+    
+    // Functions must be defined before the expression evaluated.
+    Node_id point = functions[number].node;
+    stack.resize(functions[number].locals, uninitialized);
+    frames.push_back({number, 0, 0, {}});
+    const Instruction* code = functions[number].code.data();
+    size_t pc = 0;
+    size_t base = 0;
+    size_t steps = 0;
+    for (;;)
+    {
+        if (++steps > max_steps)
+            throw Limit_error {"Constant evaluation exceeded its steps"};
+        const Instruction& i = code[pc++];
+        switch (i.op)
+        {
+            case Bytecode::constant:
+                push(i.operand);
+                break;
+            case Bytecode::load:
+            {
+                auto value = stack[base + i.operand];
+                if (value == uninitialized)
+                    fail(ast, i.node, "Use of an uninitialized variable");
+                push(value);
+                break;
+            }
+            case Bytecode::store:
+                stack[base + i.operand] = pop();
+                break;
+            case Bytecode::dup:
+                push(stack.back());
+                break;
+            case Bytecode::pop:
+                stack.pop_back();
+                break;
+            case Bytecode::convert:
+            {
+                auto& value = stack[stack.size() - 1 - i.operand];
+                value = wrap(value, i.type);
+                break;
+            }
+            case Bytecode::neg:
+                stack.back() = arithmetic(ast, i, 0, stack.back());
+                break;
+            case Bytecode::bit_not:
+                stack.back() = wrap(~stack.back(), i.type);
+                break;
+            case Bytecode::log_not:
+                stack.back() = stack.back() == 0;
+                break;
+            case Bytecode::jump:
+                pc = i.operand;
+                break;
+            case Bytecode::jump_if_zero:
+                if (pop() == 0)
+                    pc = i.operand;
+                break;
+            case Bytecode::jump_if_not_zero:
+                if (pop() != 0)
+                    pc = i.operand;
+                break;
+            case Bytecode::call:
+            {
+                auto callee = static_cast<std::uint32_t>(i.operand);
+                Node_id definition = functions[callee].node;
+                if (definition == no_node || definition > point)
+                {
+                    auto name = ast[functions[callee].declaration].value;
+                    fail(ast, i.node, "Call to an undefined function: " +
+                                                string {ast.name_text(name)});
+                }
+                size_t count = functions[callee].parameters.size();
+                Call_key key {callee, {stack.end() - count, stack.end()}};
+                auto found = memo.find(key);
+                if (found != memo.end() && found->second.point <= point)
+                {
+                    stack.resize(stack.size() - count);
+                    if (functions[callee].result.bits)
+                        push(found->second.value);
+                    break;
+                }
+                if (!functions[callee].compiled)
+                    compile(callee);
+                frames.back().pc = pc;
+                base = stack.size() - count;
+                if (base + functions[callee].locals + frames.size() >= max_stack)
+                    throw Limit_error {"Constant evaluation exceeded its memory"};
+                stack.resize(base + functions[callee].locals, uninitialized);
+                frames.push_back({callee, 0, base, std::move(key)});
+                code = functions[callee].code.data();
+                pc = 0;
+                break;
+            }
+            case Bytecode::ret:
+            case Bytecode::ret_void:
+            {
+                auto value = i.op == Bytecode::ret ? stack.back() : 0;
+                auto& done = frames.back();
+                stack.resize(done.base);
+                if (frames.size() == 1)
+                {
+                    total_steps += steps;
+                    return value;
+                }
+                if (memo.size() < max_memo)
+                    memo.insert_or_assign(std::move(done.key),
+                                                    Memoized {value, point});
+                frames.pop_back();
+                if (i.op == Bytecode::ret)
+                    push(value);
+                auto& caller = frames.back();
+                code = functions[caller.function].code.data();
+                pc = caller.pc;
+                base = caller.base;
+                break;
+            }
+            case Bytecode::fail:
+                fail(ast, i.node, "End of a function without return");
+            default:
+                stack[stack.size() - 2] = arithmetic(ast, i,
+                                    stack[stack.size() - 2], stack.back());
+                stack.pop_back();
+        }
+    }
+}
+
+void fauces::check_constants(const Ast& ast, Integer_model model)
+{
+    Constant_evaluator evaluator {ast, model};
+    for (Node_id d = ast[ast.root()].first; d != no_node; d = ast[d].next)
+    {
+        auto& node = ast[d];
+        if (node.kind == Node_kind::static_assertion)
+        {
+            if (evaluator.evaluate(node.first) == 0)
+                fail(ast, d, "Static assertion failed");
+        }
+        else if (node.kind == Node_kind::variable &&
+                                            (node.flags & declared_constexpr))
+        {
+            Node_id initializer = ast[node.first].next;
+            if (initializer == no_node)
+                fail(ast, d, "Constant without initializer");
+            evaluator.evaluate(initializer);
+        }
+    }
+}
@@ -0,0 +1,177 @@
+// evaluator.hpp
+// Evaluation of constant expressions
+//
+// Created by Alejandro Castro García on 19 October 2026
+/*
+Licensed under the MIT License.
+ 
+Copyright (c) Faustic Inferno SL
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef evaluator_hpp
+#define evaluator_hpp
+
+#include "pieces.hpp"
+#include "phase7.hpp"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace fauces
+{
+
+struct Int_type
+{
+    std::uint8_t bits = 0;      // 0 for void
+    bool is_unsigned = false;
+    
+    bool operator==(const Int_type& other) const
+    {
+        return bits == other.bits && is_unsigned == other.is_unsigned;
+    }
+};
+
+enum class Bytecode: std::uint8_t
+{
+    constant,       // Push operand
+    load,           // Push local number operand
+    store,          // Pop into local number operand
+    dup,
+    pop,
+    convert,        // To type, the value at depth operand
+    add, sub, mul, div, rem, shl, shr, bit_and, bit_or, bit_xor,
+    lt, gt, le, ge, eq, ne,
+    neg, bit_not, log_not,
+    jump,           // To instruction number operand
+    jump_if_zero,
+    jump_if_not_zero,
+    call,           // Function number operand
+    ret,
+    ret_void,
+    fail            // End of a function not returning any value
+};
+
+struct Instruction
+{
+    Bytecode op;
+    Int_type type;
+    Node_id node = no_node;     // For errors
+    std::int64_t operand = 0;
+};
+
+static_assert(sizeof(Instruction) == 16);
+
+// Evaluates constant expressions of a syntax tree. Functions are compiled
+// into bytecode the first time they are needed, and calls are memoized by
+// function and arguments, which is possible because constant evaluation has
+// no side effects outside the call. As in C++, names are only looked up
+// among the declarations before their use, and a function can only be
+// called if it is defined before the expression being evaluated. The number
+// of instructions executed and the memory used by each evaluation are
+// limited. Integers may have up to 32 bits, so that exact results always
+// fit in 64 bits.
+class Constant_evaluator
+{
+public:
+    size_t max_steps = 1 << 24;
+    size_t max_stack = 1 << 16;     // Values, including locals
+    size_t max_memo = 1 << 16;      // Memoized calls
+    
+    Constant_evaluator(const Ast& ast, Integer_model model);
+    
+    std::int64_t evaluate(Node_id expression);
+    
+    size_t steps() const
+    {
+        return total_steps;
+    }
+private:
+    struct Function
+    {
+        Node_id node;               // Definition, or the expression evaluated
+        Node_id declaration = no_node;  // The first one
+        std::vector<Instruction> code;
+        std::vector<Int_type> parameters;
+        Int_type result;
+        size_t locals = 0;
+        bool compiled = false;
+    };
+    
+    struct Call_key
+    {
+        std::uint32_t function;
+        std::vector<std::int64_t> arguments;
+        
+        bool operator==(const Call_key& other) const
+        {
+            return function == other.function && arguments == other.arguments;
+        }
+    };
+    
+    struct Call_key_hash
+    {
+        size_t operator()(const Call_key& key) const;
+    };
+    
+    // Result of a call, with the point where it was evaluated: the
+    // functions it called may be defined after an earlier point.
+    struct Memoized
+    {
+        std::int64_t value;
+        Node_id point;
+    };
+    
+    struct Global
+    {
+        Node_id node = no_node;     // Declaration
+        Int_type type;
+        std::int64_t value = 0;
+        bool evaluating = false;
+        bool evaluated = false;
+    };
+    
+    friend class Function_compiler;
+    
+    const Ast& ast;
+    Integer_model model;
+    std::vector<Function> functions;
+    std::unordered_map<std::uint32_t, std::uint32_t> function_numbers;
+    std::unordered_map<std::uint32_t, Global> globals;
+    std::unordered_map<Call_key, Memoized, Call_key_hash> memo;
+    size_t total_steps = 0;
+    
+    Int_type type_of(Node_id type) const;
+    Node_id declaration(Node_kind kind, std::uint32_t name) const;
+    std::uint32_t function_number(std::uint32_t name, Node_id where);
+    void compile(std::uint32_t number);
+    const Global& global(std::uint32_t name, Node_id where);
+    std::int64_t run(std::uint32_t number);
+};
+
+// Evaluates every constexpr variable and static_assert declaration at
+// namespace scope, so that errors are reported even if they are not used.
+void check_constants(const Ast& ast, Integer_model model);
+
+} // namespace fauces
+
+#endif /* evaluator_hpp */
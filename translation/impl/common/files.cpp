@@ -67,5 +67,98 @@ File_type identify_file_type(string filename)
     return identify_source_file(filename);
 }
 
+static string make_escape(const string& filename)
+{
+    string escaped;
+    for (char c: filename)
+    {
+        if (c == ' ' || c == '#')
+            escaped += '\\';
+        else if (c == '$')
+            escaped += '$';
+        escaped += c;
+    }
+    return escaped;
+}
+
+void save_dependencies(const Program_output& output,
+                                            const std::vector<string>& sources)
+{
+    using std::ios;
+    string temp = output.dep_file + ".tmp";
+    std::ofstream ofs;
+    ofs.exceptions(ios::failbit | ios::badbit);
+    try
+    {
+        ofs.open(temp, ios::trunc);
+    }
+    catch (...)
+    {
+        throw File_error_cantopen();
+    }
+    try
+    {
+        ofs << make_escape(output.value) << ":";
+        for (auto& source: sources)
+            ofs << " \\\n " << make_escape(source);
+        ofs << "\n";
+        // Removed sources must not break the build: they just make the
+        // output out of date.
+        for (auto& source: sources)
+            ofs << "\n" << make_escape(source) << ":\n";
+        ofs.close();
+        std::filesystem::rename(temp, output.dep_file);
+    }
+    catch (...)
+    {
+        std::error_code ec;
+        std::filesystem::remove(temp, ec);
+        throw File_error_write();
+    }
+}
+
+auto Unit_cache::new_entry(unique_ptr<Translated_unit> unit, string printed)
+-> Entry
+{
+    Entry entry;
+    for (auto& source: unit->sources)
+    {
+        entry.stamps.emplace_back(std::filesystem::absolute(source).string(),
+                                                        file_stamp(source));
+    }
+    entry.unit = std::move(unit);
+    entry.printed = std::move(printed);
+    return entry;
+}
+
+bool Unit_cache::is_current(const Entry& entry)
+{
+    for (auto& [path, stamp]: entry.stamps)
+    {
+        try
+        {
+            if (!(file_stamp(path) == stamp))
+                return false;
+        }
+        catch (File_error_cantopen)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+File_stamp file_stamp(string filename)
+{
+    std::error_code time_error;
+    std::error_code size_error;
+    File_stamp stamp;
+    stamp.time = std::filesystem::last_write_time(filename, time_error);
+    stamp.size = std::filesystem::file_size(filename, size_error);
+    if (time_error || size_error)
+        throw File_error_cantopen();
+    return stamp;
+}
+
 
 } // namespace fauces
@@ -117,6 +117,7 @@ unique_ptr<Translated_unit> Fo16_unit_loader::load()
     cout << "load\n";
     
     unique_ptr<Translated_unit> unit = make_unique<Translated_unit>();
+    unit->sources.push_back(path);
     for (unsigned short i = 0; load_section(ifs, unit.get(), i); ++i)
         ;
     for (auto i = symrec.begin(); i != symrec.end(); ++i)
@@ -191,7 +192,8 @@ void Fo16_unit_loader::init(std::ifstream& ifs)
 
 } // namespace fauces
 
-void fauces::Fo16_program_saver::init(std::ofstream &ofs)
+template<typename Arch>
+void fauces::Fo16_program_saver<Arch>::init(std::ofstream &ofs)
 {
     using std::ios;
     ofs.exceptions(ios::failbit | ios::badbit);
@@ -208,7 +210,7 @@ void fauces::Fo16_program_saver::init(std::ofstream &ofs)
         const auto& data = Fo16_unit_loader::signature.data();
         const auto size = Fo16_unit_loader::signature.size();
         write(ofs, data, size);
-        save_short(ofs, static_cast<unsigned short>(Cpu_type::visy));
+        save_short(ofs, Arch::fo16_cpu);
         save_short(ofs, pref_code_id);
         save_short(ofs, pref_start);
     }
@@ -218,7 +220,8 @@ void fauces::Fo16_program_saver::init(std::ofstream &ofs)
     }
 }
 
-void fauces::Fo16_program_saver::save(Linked_program &prog)
+template<typename Arch>
+void fauces::Fo16_program_saver<Arch>::save(Linked_program<Arch> &prog)
 {
     prog.verify();
     std::ofstream ofs;
@@ -239,7 +242,8 @@ void fauces::Fo16_program_saver::save(Linked_program &prog)
     }
 }
 
-void fauces::Fo16_program_saver::save_section(std::ofstream &ofs,
+template<typename Arch>
+void fauces::Fo16_program_saver<Arch>::save_section(std::ofstream &ofs,
     unsigned char id, Sec_type type, const std::vector<unsigned char>& bytes)
 {
     save_short(ofs, id);
@@ -249,7 +253,9 @@ void fauces::Fo16_program_saver::save_section(std::ofstream &ofs,
     write(ofs, bytes.data(), bytes.size());
 }
 
-void fauces::Fo16_program_saver::save_eof(std::ofstream &ofs, unsigned char id)
+template<typename Arch>
+void fauces::Fo16_program_saver<Arch>::save_eof
+                                        (std::ofstream &ofs, unsigned char id)
 {
     save_short(ofs, id);
     save_short(ofs, static_cast<unsigned short>(Sec_type::eof));
@@ -257,3 +263,6 @@ void fauces::Fo16_program_saver::save_eof(std::ofstream &ofs, unsigned char id)
     save_short(ofs, size);
     save_short(ofs, pref_start);
 }
+
+// Every supported architecture must be listed here.
+template class fauces::Fo16_program_saver<fauces::arch::Visy>;
@@ -180,16 +180,18 @@ private:
             (Translated_unit* unit, const std::vector<unsigned char>& content);
 };
 
-class Fo16_program_saver : public Linked_program_saver
+template<typename Arch>
+class Fo16_program_saver
 {
+    static_assert(Arch::address_bits == 16);
 public:
     Fo16_program_saver(const std::string& path) : path {path} {};
+    void save(Linked_program<Arch>& prog);
 private:
     const std::string path;
     static constexpr unsigned short pref_code_id = 0;
     static constexpr unsigned short pref_start = 0;
     void init(std::ofstream &ofs);
-    void save(Linked_program& prog) override;
     void save_section (std::ofstream &ofs, unsigned char id, Sec_type type,
                                     const std::vector<unsigned char>& bytes);
     void save_eof(std::ofstream &ofs, unsigned char id);
@@ -29,9 +29,15 @@ SOFTWARE.
 #include "phase1.hpp"
 #include "phase2.hpp"
 #include "phase3.hpp"
+#include "phase4.hpp"
 
 #include "translator.hpp"
 
+#include <thread>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+
 namespace fauces
 {
 
@@ -183,7 +189,12 @@ static Token parse_div(Source_context& context)
     Token token {src, Token_type::pp_op_or_punc};
     token.text = "/";
     next_ch(context);
-    if (peek_ch(context) == U'/')
+    if (peek_ch(context) == U'=')
+    {
+        token.text = "/=";
+        next_ch(context);
+    }
+    else if (peek_ch(context) == U'/')
     {
         token.text = " ";
         token.type = Token_type::white;
@@ -196,12 +207,17 @@ static Token parse_div(Source_context& context)
         token.type = Token_type::white;
         for (;;)
         {
-            auto pos = context.line.find(U"*/");
+            auto pos = context.line.find(U"*/", context.line_start + src.col);
             if (pos == string::npos)
+            {
+                if (!context.line.empty() &&
+                                        context.line.back() == unicode_beot)
+                    throw Unterminated_comment {{"Unterminated comment"}};
                 next_line(context);
+            }
             else
             {
-                context.src.col = context.line_start + pos + 2;
+                context.src.col = pos + 2 - context.line_start;
                 break;
             }
         }
@@ -296,6 +312,38 @@ static Token parse_punc(Source_context &context)
     return token;
 }
 
+// Operators and punctuators made of several characters, longest first.
+static const char* const long_operators[]
+{
+    "<<=", ">>=", "->*", "<=>", "...",
+    "::", "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "##"
+};
+
+static Token parse_operator(Source_context &context)
+{
+    auto& src = context.src;
+    Token token{src, Token_type::pp_op_or_punc};
+    auto& line = context.line;
+    auto start = context.line_start + src.col;
+    for (auto op: long_operators)
+    {
+        size_t size = std::char_traits<char>::length(op);
+        if (start + size > line.size())
+            continue;
+        size_t i = 0;
+        while (i < size && line[start + i] == char32_t(op[i]))
+            ++i;
+        if (i == size)
+        {
+            token.text = op;
+            src.col += size;
+            return token;
+        }
+    }
+    return parse_punc(context);
+}
+
 static Token& parse_number(Source_context &context, Token& token)
 {
     do
@@ -365,7 +413,12 @@ unordered_map<char32_t, Parse_token> parse
     {U'.', parse_fullstop}, {U'0', parse_number}, {U'1', parse_number},
     {U'2', parse_number}, {U'3', parse_number}, {U'4', parse_number},
     {U'5', parse_number}, {U'6', parse_number}, {U'7', parse_number},
-    {U'8', parse_number}, {U'9', parse_number}
+    {U'8', parse_number}, {U'9', parse_number}, {U'+', parse_operator},
+    {U'-', parse_operator}, {U'*', parse_operator}, {U'%', parse_operator},
+    {U'<', parse_operator}, {U'>', parse_operator}, {U'=', parse_operator},
+    {U'!', parse_operator}, {U'&', parse_operator}, {U'|', parse_operator},
+    {U'^', parse_operator}, {U'~', parse_operator}, {U',', parse_operator},
+    {U'?', parse_operator}, {U':', parse_operator}, {U'#', parse_operator}
 };
 
 static Token parse_token(char32_t start, Source_context& context)
@@ -398,24 +451,152 @@ static Token next_token(Source_context& context)
     }
 }
 
-} // namespace fauces
-
-auto fauces::Preprocessor::pretokenize(const string& path) -> list<Token>
+// Tokens of a whole file, or of a part of it ending with a new-line. The
+// end of a file gives a final new-line, and the end of a part gives nothing.
+static list<Token> lex(Source_context& context, bool first, bool last)
 {
     list<Token> tokens;
-    Source_context context {path};
-    context.line = readline(context.is, true);
+    context.line = readline(context.is, first);
     for (Token token {context.src};;)
     {
         token = next_token(context);
-        tokens.push_back(token);
         if (token.type == Token_type::eof)
         {
-            auto& last_token = tokens.back();
-            last_token.text = "\n";
-            last_token.type = Token_type::white;
+            if (last)
+            {
+                token.text = "\n";
+                token.type = Token_type::white;
+                tokens.push_back(token);
+            }
             break;
         }
+        tokens.push_back(token);
     }
     return tokens;
 }
+
+struct Lexed_chunk
+{
+    size_t begin;
+    size_t lineno;
+    list<Token> tokens;
+    std::exception_ptr error;
+};
+
+// Chunks end right after a new-line, but never after one that is part of a
+// line splice, so that every line is entirely inside one chunk.
+static vector<Lexed_chunk> split_chunks(const string& content, unsigned count)
+{
+    vector<Lexed_chunk> chunks;
+    size_t target = std::max<size_t>(content.size() / count, 1);
+    size_t lineno = 0;
+    for (size_t begin = 0; begin < content.size();)
+    {
+        chunks.push_back({begin, lineno, {}, nullptr});
+        size_t end = begin + target;
+        for (; end < content.size(); ++end)
+        {
+            if (content[end] == '\n' && content[end - 1] != '\\')
+                break;
+        }
+        end = std::min(end + 1, content.size());
+        lineno += std::count(content.begin() + begin, content.begin() + end,
+                                                                        '\n');
+        begin = end;
+    }
+    return chunks;
+}
+
+static void lex_chunks(const string& path, const string& content,
+                    vector<Lexed_chunk>& chunks, size_t first, size_t last)
+{
+    auto& chunk = chunks[first];
+    size_t end = last + 1 < chunks.size() ? chunks[last + 1].begin :
+                                                                content.size();
+    try
+    {
+        Source_context context {content.substr(chunk.begin, end - chunk.begin),
+                                        Source_location {path, chunk.lineno}};
+        chunk.tokens = lex(context, first == 0, last + 1 == chunks.size());
+        chunk.error = nullptr;
+    }
+    catch (...)
+    {
+        chunk.tokens.clear();
+        chunk.error = std::current_exception();
+    }
+}
+
+static list<Token> lex_parallel(const string& path, unsigned threads)
+{
+    std::ifstream is;
+    is.exceptions(is.failbit | is.badbit);
+    is.open(path, is.binary);
+    string content {std::istreambuf_iterator<char>(is), {}};
+    if (content.empty())
+    {
+        Source_context context {path};
+        return lex(context, true, true);
+    }
+    auto chunks = split_chunks(content, threads);
+    {
+        vector<std::thread> workers;
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            workers.emplace_back(lex_chunks, std::cref(path),
+                                        std::cref(content), std::ref(chunks), i, i);
+        }
+        for (auto& w: workers)
+            w.join();
+    }
+    // Every chunk was lexed as if it started outside any comment, which is
+    // true only if the previous one was lexed successfully. A comment
+    // crossing the seam is found as an unterminated comment at the end of
+    // the previous chunk, which is then lexed again together with the next.
+    list<Token> tokens;
+    for (size_t first = 0, last = 0; first < chunks.size(); first = ++last)
+    {
+        for (;;)
+        {
+            try
+            {
+                if (chunks[first].error)
+                    std::rethrow_exception(chunks[first].error);
+                break;
+            }
+            catch (Unterminated_comment)
+            {
+                if (last + 1 == chunks.size())
+                    throw;
+                lex_chunks(path, content, chunks, first, ++last);
+            }
+        }
+        tokens.splice(tokens.end(), chunks[first].tokens);
+    }
+    return tokens;
+}
+
+} // namespace fauces
+
+auto fauces::Preprocessor::lex(const string& path, unsigned threads)
+-> list<Token>
+{
+    if (threads > 1)
+        return lex_parallel(path, threads);
+    Source_context context {path};
+    return fauces::lex(context, true, true);
+}
+
+auto fauces::Preprocessor::pretokenize(const string& path, Include_guard& guard)
+-> list<Token>
+{
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    unsigned threads = !ec && size >= parallel_lexing_size ? lexing_threads : 1;
+    list<Token> tokens = lex(path, threads);
+    Guard_detector detector;
+    for (auto& token: tokens)
+        detector.feed(token);
+    guard.macro = detector.guard_macro();
+    return tokens;
+}
@@ -31,8 +31,311 @@ SOFTWARE.
 
 #include "translator.hpp"
 
-void fauces::Preprocessor::execute_directives(list<Token>& tokens, size_t level)
+#include <filesystem>
+
+namespace fauces
+{
+
+static bool is_new_line(const Token& token)
+{
+    return token.type == Token_type::white && token.text == "\n";
+}
+
+void Guard_detector::feed(const Token& token)
+{
+    if (state == State::none)
+        return;
+    if (is_new_line(token))
+        end_line();
+    else if (token.type != Token_type::white)
+        line.push_back(token.text);
+}
+
+void Guard_detector::end_line()
+{
+    bool directive = line.size() >= 2 && line[0] == "#";
+    if (line.empty())
+        ;
+    else if (state == State::start)
+    {
+        if (directive && line.size() == 3 && line[1] == "ifndef")
+        {
+            macro = line[2];
+            depth = 1;
+            state = State::open;
+        }
+        else
+            state = State::none;
+    }
+    else if (state == State::open)
+    {
+        if (directive && line[1].substr(0, 2) == "if")
+            ++depth;
+        else if (directive && line[1] == "endif" && !--depth)
+            state = State::closed;
+        else if (directive && depth == 1 &&
+                                    (line[1] == "else" || line[1] == "elif"))
+            state = State::none;
+    }
+    else
+        state = State::none;
+    line.clear();
+}
+
+struct Conditional
+{
+    bool active;        // Lines in the current group are kept
+    bool taken;         // Some group has already been kept
+    bool enclosing;     // Lines around the conditional are kept
+    bool seen_else;
+};
+
+using Token_iterator = list<Token>::iterator;
+
+// Non-white tokens of a line, excluding the final new-line.
+static vector<Token_iterator> line_words(Token_iterator begin,
+                                                        Token_iterator end)
+{
+    vector<Token_iterator> words;
+    for (auto i = begin; i != end; ++i)
+    {
+        if (i->type != Token_type::white)
+            words.push_back(i);
+    }
+    return words;
+}
+
+static string macro_name(const vector<Token_iterator>& words)
+{
+    if (words.size() != 3 || words[2]->type != Token_type::identifier)
+        throw Syntax_error {"Expected a macro name after #" + words[1]->text};
+    return words[2]->text;
+}
+
+// Spelling of a "q-char-sequence" header name, made of every token between
+// the quotes.
+static string header_name(const vector<Token_iterator>& words)
+{
+    if (words.size() < 4 || words[2]->text != "\"" ||
+                                                    words.back()->text != "\"")
+        throw Syntax_error {"Only #include \"file\" is supported yet"};
+    string name;
+    for (auto i = std::next(words[2]); i != words.back(); ++i)
+        name += i->text;
+    return name;
+}
+
+static bool is_include(const vector<Token_iterator>& words)
+{
+    return words.size() >= 4 && words[0]->text == "#" &&
+                words[1]->text == "include" && words[2]->text == "\"" &&
+                                                    words.back()->text == "\"";
+}
+
+static string include_path(const vector<Token_iterator>& words)
+{
+    std::filesystem::path includer {words[0]->src.path};
+    return Preprocessor::include_key
+                        ((includer.parent_path() / header_name(words)).string());
+}
+
+// Files that a token list may include, as long as they are not known to be
+// skipped. Conditional inclusion is ignored: prefetching is speculative.
+static vector<string> wanted_includes(list<Token>& tokens,
+                                                const Preprocessing_state& state)
+{
+    vector<string> paths;
+    auto line_begin = tokens.begin();
+    while (line_begin != tokens.end())
+    {
+        auto line_end = std::find_if(line_begin, tokens.end(), is_new_line);
+        auto words = line_words(line_begin, line_end);
+        if (is_include(words))
+        {
+            string path = include_path(words);
+            auto known = state.guards.find(path);
+            if (known == state.guards.end() ||
+                                    (!known->second.once &&
+                                    !state.macros.count(known->second.macro)))
+                paths.push_back(path);
+        }
+        line_begin = line_end == tokens.end() ? line_end : std::next(line_end);
+    }
+    return paths;
+}
+
+} // namespace fauces
+
+fauces::Include_prefetcher::~Include_prefetcher()
+{
+    {
+        std::lock_guard lock {mutex};
+        stop = true;
+    }
+    wanted.notify_one();
+    if (worker.joinable())
+        worker.join();
+}
+
+void fauces::Include_prefetcher::prefetch(const vector<string>& paths)
+{
+    {
+        std::lock_guard lock {mutex};
+        for (auto i = paths.rbegin(); i != paths.rend(); ++i)
+        {
+            if (!started.count(*i) && queued.insert(*i).second)
+                queue.push_front(*i);
+        }
+        if (!worker.joinable() && !queue.empty())
+            worker = std::thread {&Include_prefetcher::work, this};
+    }
+    wanted.notify_one();
+}
+
+auto fauces::Include_prefetcher::take(const string& path, Include_guard& guard)
+-> list<Token>
+{
+    std::unique_lock lock {mutex};
+    auto i = started.find(path);
+    if (i == started.end())
+    {
+        // Not started yet: faster to do it right here. The worker will skip
+        // it when it reaches it in the queue.
+        queued.erase(path);
+        lock.unlock();
+        return Preprocessor::pretokenize(path, guard);
+    }
+    auto result = std::move(i->second);
+    started.erase(i);
+    lock.unlock();
+    Prefetched_file file = result.get();
+    guard.macro = file.guard_macro;
+    return std::move(file.tokens);
+}
+
+void fauces::Include_prefetcher::work()
+{
+    std::unique_lock lock {mutex};
+    for (;;)
+    {
+        wanted.wait(lock, [this] {return stop || !queue.empty();});
+        if (stop)
+            return;
+        string path = queue.front();
+        queue.pop_front();
+        if (!queued.erase(path))
+            continue;
+        std::promise<Prefetched_file> promise;
+        started.emplace(path, promise.get_future());
+        lock.unlock();
+        try
+        {
+            Include_guard guard;
+            list<Token> tokens = Preprocessor::pretokenize(path, guard);
+            promise.set_value({std::move(tokens), guard.macro});
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+        lock.lock();
+    }
+}
+
+auto fauces::Preprocessor::include_key(const string& path) -> string
+{
+    return std::filesystem::path {path}.lexically_normal().string();
+}
+
+void fauces::Preprocessor::execute_directives
+                (list<Token>& tokens, Preprocessing_state& state, size_t level)
 {
-    // No directives are supported yet.
-    // For the time being, this acts like a no-op.
+    vector<Conditional> conditionals;
+    state.prefetcher.prefetch(wanted_includes(tokens, state));
+    auto line_begin = tokens.begin();
+    while (line_begin != tokens.end())
+    {
+        auto line_end = std::find_if(line_begin, tokens.end(), is_new_line);
+        auto words = line_words(line_begin, line_end);
+        bool active = conditionals.empty() || conditionals.back().active;
+        list<Token> replacement;
+        if (words.empty() || words[0]->text != "#")
+        {
+            if (!active)
+                tokens.erase(line_begin, line_end);
+        }
+        else
+        {
+            string directive = words.size() > 1 ? words[1]->text : "";
+            if (directive == "ifdef" || directive == "ifndef")
+            {
+                bool taken = active &&
+                    state.macros.count(macro_name(words)) ==
+                                                        (directive == "ifdef");
+                conditionals.push_back({taken, taken, active, false});
+            }
+            else if (directive == "if" && !active)
+                conditionals.push_back({false, true, false, false});
+            else if (directive == "else")
+            {
+                if (conditionals.empty() || conditionals.back().seen_else)
+                    throw Syntax_error {"Unexpected #else"};
+                auto& c = conditionals.back();
+                c.active = c.enclosing && !c.taken;
+                c.taken = true;
+                c.seen_else = true;
+            }
+            else if (directive == "endif")
+            {
+                if (conditionals.empty())
+                    throw Syntax_error {"Unexpected #endif"};
+                conditionals.pop_back();
+            }
+            else if (directive == "elif")
+                throw Syntax_error {"Directive not supported yet: #elif"};
+            else if (!active || directive.empty())
+                ;
+            else if (directive == "define")
+            {
+                if (words.size() > 3)
+                    throw Syntax_error {"Macro replacement not supported yet"};
+                state.macros.insert(macro_name(words));
+            }
+            else if (directive == "undef")
+                state.macros.erase(macro_name(words));
+            else if (directive == "pragma")
+            {
+                // Other pragmas are ignored.
+                if (words.size() == 3 && words[2]->text == "once")
+                    state.guards[words[0]->src.path].once = true;
+            }
+            else if (directive == "include")
+            {
+                string key = include_path(words);
+                // A guarded file is skipped without even opening it.
+                auto known = state.guards.find(key);
+                if (known == state.guards.end() || !(known->second.once ||
+                    (known->second.macro.size() &&
+                                    state.macros.count(known->second.macro))))
+                {
+                    if (level + 1 > max_include)
+                        throw Limit_error {"Included file is too nested"};
+                    replacement = state.prefetcher.take(key, state.guards[key]);
+                    auto& sources = state.sources;
+                    if (std::find(sources.begin(), sources.end(), key) ==
+                                                                sources.end())
+                        sources.push_back(key);
+                    execute_directives(replacement, state, level + 1);
+                }
+            }
+            else
+                throw Syntax_error {"Directive not supported yet: #" +
+                                                                    directive};
+            tokens.erase(line_begin, line_end);
+            tokens.splice(line_end, replacement);
+        }
+        line_begin = line_end == tokens.end() ? line_end : std::next(line_end);
+    }
+    if (!conditionals.empty())
+        throw Syntax_error {"Missing #endif"};
 }
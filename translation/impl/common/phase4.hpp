@@ -30,6 +30,35 @@ SOFTWARE.
 #ifndef phase4_hpp
 #define phase4_hpp
 
+#include "pieces.hpp"
 
+#include <vector>
+#include <string>
+
+namespace fauces
+{
+
+// Recognizes, token by token, a file whose whole content is wrapped in
+// #ifndef MACRO ... #endif, so that it can be skipped when included again
+// while MACRO is still defined.
+class Guard_detector
+{
+public:
+    void feed(const Token& token);
+    string guard_macro() const
+    {
+        return state == State::closed ? macro : string {};
+    }
+private:
+    enum class State {start, open, closed, none};
+    State state = State::start;
+    string macro;
+    size_t depth = 0;
+    std::vector<string> line;
+    
+    void end_line();
+};
+
+}
 
 #endif /* phase4_hpp */
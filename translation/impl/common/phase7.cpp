@@ -32,6 +32,9 @@ SOFTWARE.
 #include "translator.hpp"
 
 #include <iostream>
+#include <cstring>
+#include <optional>
+#include <string>
 
 // Phase 7 requires full implementation of Translator::analyze
 
@@ -52,3 +55,533 @@ void fauces::bad_token(size_t index, const Token& t)
     std::cerr << index << ". Unknown: " << t.text << "\n";
 }
 
+void* fauces::Arena::allocate(size_t size, size_t alignment)
+{
+    if (size > block_size / 4)
+    {
+        big_blocks.push_back(std::make_unique<std::byte[]>(size));
+        return big_blocks.back().get();
+    }
+    size_t start = (used + alignment - 1) / alignment * alignment;
+    if (start + size > block_size)
+    {
+        blocks.push_back(std::make_unique<std::byte[]>(block_size));
+        start = 0;
+    }
+    used = start + size;
+    return blocks.back().get() + start;
+}
+
+auto fauces::Arena::store(std::string_view text) -> std::string_view
+{
+    auto data = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(data, text.data(), text.size());
+    return {data, text.size()};
+}
+
+fauces::Ast::Ast()
+{
+    nodes.emplace_back();
+    lines.push_back(0);
+    add(Node_kind::translation_unit, 0, 0);
+}
+
+auto fauces::Ast::add(Node_kind kind, std::uint32_t value, std::uint32_t line)
+-> Node_id
+{
+    if (nodes.size() > UINT32_MAX)
+        throw Limit_error {"Too many nodes in a translation unit"};
+    Node_id id = static_cast<Node_id>(nodes.size());
+    Node node;
+    node.kind = kind;
+    node.value = value;
+    nodes.push_back(node);
+    lines.push_back(line);
+    return id;
+}
+
+void fauces::Ast::source(std::string_view path)
+{
+    if (files.empty() || files.back().second != path)
+        files.emplace_back(static_cast<Node_id>(nodes.size()),
+                                                            arena.store(path));
+}
+
+auto fauces::Ast::location(Node_id id) const -> std::string
+{
+    std::string_view path;
+    for (auto& [first, p]: files)
+    {
+        if (first > id)
+            break;
+        path = p;
+    }
+    return std::string {path} + ":" + std::to_string(lines[id]) + ": ";
+}
+
+auto fauces::Ast::name(std::string_view text) -> std::uint32_t
+{
+    auto i = name_ids.find(text);
+    if (i != name_ids.end())
+        return i->second;
+    auto stored = arena.store(text);
+    auto id = static_cast<std::uint32_t>(names.size());
+    names.push_back(stored);
+    name_ids.emplace(stored, id);
+    return id;
+}
+
+namespace fauces
+{
+
+struct Binary_op
+{
+    const char* text;
+    Op op;
+    int precedence;
+};
+
+// Higher precedence binds tighter. Assignment is handled apart, because it
+// associates to the right.
+static const Binary_op binary_ops[]
+{
+    {"||", Op::log_or, 1}, {"&&", Op::log_and, 2}, {"|", Op::bit_or, 3},
+    {"^", Op::bit_xor, 4}, {"&", Op::bit_and, 5},
+    {"==", Op::eq, 6}, {"!=", Op::ne, 6},
+    {"<", Op::lt, 7}, {">", Op::gt, 7}, {"<=", Op::le, 7}, {">=", Op::ge, 7},
+    {"<<", Op::shl, 8}, {">>", Op::shr, 8},
+    {"+", Op::add, 9}, {"-", Op::sub, 9},
+    {"*", Op::mul, 10}, {"/", Op::div, 10}, {"%", Op::rem, 10}
+};
+
+static const std::pair<const char*, Op> unary_ops[]
+{
+    {"-", Op::neg}, {"+", Op::pos}, {"!", Op::log_not}, {"~", Op::bit_not},
+    {"*", Op::deref}, {"&", Op::address}
+};
+
+static const char* const type_keywords[]
+{
+    "void", "char", "int", "signed", "unsigned", "const"
+};
+
+static const char* const keywords[]
+{
+    "void", "char", "int", "signed", "unsigned", "const", "return", "if",
+    "else", "constexpr", "static_assert"
+};
+
+// Recursive descent parser for the small subset of C++ needed by our first
+// experiments: functions, local variables, return, if and integer
+// expressions.
+class Parser
+{
+public:
+    Parser(list<Token>& tokens, Ast& ast):
+    pos {tokens.begin()}, end {tokens.end()}, ast {ast}
+    {}
+    
+    void translation_unit();
+private:
+    list<Token>::iterator pos;
+    list<Token>::iterator end;
+    Ast& ast;
+    
+    [[noreturn]] void error(const string& msg) const;
+    bool is(const char* text) const;
+    bool is_keyword() const;
+    bool is_type() const;
+    bool accept(const char* text);
+    void expect(const char* text);
+    std::uint32_t line();
+    std::uint32_t name();
+    
+    Node_id type();
+    Node_id declaration(Node_id type, std::uint32_t name, std::uint32_t line);
+    Node_id function(Node_id type, std::uint32_t name, std::uint32_t line);
+    Node_id statement();
+    Node_id compound();
+    Node_id expression();
+    Node_id binary(int min_precedence);
+    Node_id unary();
+    Node_id postfix();
+    Node_id primary();
+    Node_id integer();
+};
+
+void Parser::error(const string& msg) const
+{
+    string where;
+    if (pos != end)
+        where = pos->src.path + ":" + std::to_string(pos->src.lineno + 1) +
+                                                                        ": ";
+    throw Syntax_error {where + msg};
+}
+
+bool Parser::is(const char* text) const
+{
+    return pos != end && pos->type != Token_type::unknown && pos->text == text;
+}
+
+bool Parser::is_keyword() const
+{
+    for (auto k: keywords)
+    {
+        if (is(k))
+            return true;
+    }
+    return false;
+}
+
+bool Parser::is_type() const
+{
+    for (auto k: type_keywords)
+    {
+        if (is(k))
+            return true;
+    }
+    return false;
+}
+
+bool Parser::accept(const char* text)
+{
+    if (!is(text))
+        return false;
+    ++pos;
+    return true;
+}
+
+void Parser::expect(const char* text)
+{
+    if (!accept(text))
+        error(string {"Expected "} + text);
+}
+
+std::uint32_t Parser::line()
+{
+    if (pos == end)
+        return 0;
+    ast.source(pos->src.path);
+    return static_cast<std::uint32_t>(pos->src.lineno + 1);
+}
+
+std::uint32_t Parser::name()
+{
+    if (pos == end || pos->type != Token_type::identifier || is_keyword())
+        error("Expected a name");
+    return ast.name((pos++)->text);
+}
+
+void Parser::translation_unit()
+{
+    Child_list declarations {ast, ast.root()};
+    while (pos != end)
+    {
+        auto l = line();
+        if (accept("static_assert"))
+        {
+            Node_id s = ast.add(Node_kind::static_assertion, 0, l);
+            expect("(");
+            ast[s].first = expression();
+            expect(")");
+            expect(";");
+            declarations.add(s);
+            continue;
+        }
+        bool is_constexpr = accept("constexpr");
+        Node_id t = type();
+        std::uint32_t n = name();
+        Node_id d;
+        if (is("("))
+            d = function(t, n, l);
+        else
+        {
+            d = declaration(t, n, l);
+            expect(";");
+        }
+        ast[d].flags = is_constexpr ? declared_constexpr : 0;
+        declarations.add(d);
+    }
+}
+
+Node_id Parser::type()
+{
+    auto l = line();
+    int sign = 0;
+    bool is_const = false;
+    std::optional<Base_type> base;
+    for (;;)
+    {
+        if (accept("const"))
+            is_const = true;
+        else if (accept("signed"))
+            sign = sign ? 3 : 1;
+        else if (accept("unsigned"))
+            sign = sign ? 3 : 2;
+        else if (!base && accept("void"))
+            base = Base_type::void_type;
+        else if (!base && accept("char"))
+            base = Base_type::char_type;
+        else if (!base && accept("int"))
+            base = Base_type::int_type;
+        else
+            break;
+    }
+    if (sign == 3 || (!base && !sign) ||
+                                    (sign && base == Base_type::void_type))
+        error("Bad type");
+    if (base == Base_type::char_type && sign)
+        base = sign == 1 ? Base_type::signed_char : Base_type::unsigned_char;
+    else if (!base || base == Base_type::int_type)
+        base = sign == 2 ? Base_type::unsigned_int : Base_type::int_type;
+    std::uint16_t depth = 0;
+    while (accept("*"))
+    {
+        if (++depth == 0x100)
+            error("Too many pointers");
+    }
+    Node_id t = ast.add(Node_kind::type, static_cast<std::uint32_t>(*base), l);
+    ast[t].flags = depth | (is_const ? type_const : 0);
+    return t;
+}
+
+Node_id Parser::declaration(Node_id t, std::uint32_t n, std::uint32_t l)
+{
+    Node_id v = ast.add(Node_kind::variable, n, l);
+    Child_list children {ast, v};
+    children.add(t);
+    if (accept("="))
+        children.add(expression());
+    return v;
+}
+
+Node_id Parser::function(Node_id t, std::uint32_t n, std::uint32_t l)
+{
+    Node_id f = ast.add(Node_kind::function, n, l);
+    Child_list children {ast, f};
+    children.add(t);
+    expect("(");
+    auto after_void = std::next(pos);
+    if (is("void") && after_void != end && after_void->text == ")")
+        ++pos;
+    else if (!is(")"))
+    {
+        do
+        {
+            auto pl = line();
+            Node_id pt = type();
+            std::uint32_t pn = 0;
+            if (!is(",") && !is(")"))
+                pn = name() + 1;
+            // Unnamed parameters have value 0; others have their name + 1.
+            Node_id p = ast.add(Node_kind::parameter, pn, pl);
+            ast[p].first = pt;
+            children.add(p);
+        } while (accept(","));
+    }
+    expect(")");
+    if (!accept(";"))
+        children.add(compound());
+    return f;
+}
+
+Node_id Parser::compound()
+{
+    Node_id c = ast.add(Node_kind::compound, 0, line());
+    expect("{");
+    Child_list statements {ast, c};
+    while (!accept("}"))
+    {
+        if (pos == end)
+            error("Expected }");
+        statements.add(statement());
+    }
+    return c;
+}
+
+Node_id Parser::statement()
+{
+    auto l = line();
+    if (is("{"))
+        return compound();
+    if (accept("return"))
+    {
+        Node_id r = ast.add(Node_kind::return_statement, 0, l);
+        if (!is(";"))
+            ast[r].first = expression();
+        expect(";");
+        return r;
+    }
+    if (accept("if"))
+    {
+        Node_id s = ast.add(Node_kind::if_statement, 0, l);
+        Child_list children {ast, s};
+        expect("(");
+        children.add(expression());
+        expect(")");
+        children.add(statement());
+        if (accept("else"))
+            children.add(statement());
+        return s;
+    }
+    bool is_constexpr = accept("constexpr");
+    if (is_constexpr || is_type())
+    {
+        Node_id t = type();
+        Node_id d = declaration(t, name(), l);
+        expect(";");
+        ast[d].flags = is_constexpr ? declared_constexpr : 0;
+        return d;
+    }
+    Node_id s = ast.add(Node_kind::expression_statement, 0, l);
+    if (!is(";"))
+        ast[s].first = expression();
+    expect(";");
+    return s;
+}
+
+Node_id Parser::expression()
+{
+    auto l = line();
+    Node_id left = binary(1);
+    if (!accept("="))
+        return left;
+    Node_id a = ast.add(Node_kind::binary, 0, l);
+    ast[a].op = Op::assign;
+    ast[a].first = left;
+    ast[left].next = expression();
+    return a;
+}
+
+Node_id Parser::binary(int min_precedence)
+{
+    Node_id left = unary();
+    for (;;)
+    {
+        const Binary_op* found = nullptr;
+        for (auto& b: binary_ops)
+        {
+            if (is(b.text) && b.precedence >= min_precedence)
+            {
+                found = &b;
+                break;
+            }
+        }
+        if (!found)
+            return left;
+        auto l = line();
+        ++pos;
+        Node_id right = binary(found->precedence + 1);
+        Node_id b = ast.add(Node_kind::binary, 0, l);
+        ast[b].op = found->op;
+        ast[b].first = left;
+        ast[left].next = right;
+        left = b;
+    }
+}
+
+Node_id Parser::unary()
+{
+    for (auto& [text, op]: unary_ops)
+    {
+        if (is(text))
+        {
+            Node_id u = ast.add(Node_kind::unary, 0, line());
+            ++pos;
+            ast[u].op = op;
+            ast[u].first = unary();
+            return u;
+        }
+    }
+    return postfix();
+}
+
+Node_id Parser::postfix()
+{
+    Node_id e = primary();
+    for (;;)
+    {
+        auto l = line();
+        if (accept("("))
+        {
+            Node_id c = ast.add(Node_kind::call, 0, l);
+            Child_list children {ast, c};
+            children.add(e);
+            if (!is(")"))
+            {
+                do
+                    children.add(expression());
+                while (accept(","));
+            }
+            expect(")");
+            e = c;
+        }
+        else if (accept("["))
+        {
+            Node_id s = ast.add(Node_kind::subscript, 0, l);
+            ast[s].first = e;
+            ast[e].next = expression();
+            expect("]");
+            e = s;
+        }
+        else
+            return e;
+    }
+}
+
+Node_id Parser::primary()
+{
+    if (accept("("))
+    {
+        Node_id e = expression();
+        expect(")");
+        return e;
+    }
+    if (pos != end && pos->type == Token_type::pp_number)
+        return integer();
+    auto l = line();
+    return ast.add(Node_kind::name, name(), l);
+}
+
+Node_id Parser::integer()
+{
+    string text;
+    for (char c: pos->text)
+    {
+        if (c != '\'')
+            text += c;
+    }
+    bool is_unsigned = false;
+    while (!text.empty() && std::strchr("uUlL", text.back()))
+    {
+        if (text.back() == 'u' || text.back() == 'U')
+            is_unsigned = true;
+        text.pop_back();
+    }
+    unsigned long long value = 0;
+    size_t used = 0;
+    try
+    {
+        value = std::stoull(text, &used, 0);
+    }
+    catch (...)
+    {
+        error("Bad integer literal: " + pos->text);
+    }
+    if (used != text.size() || value > UINT32_MAX)
+        error("Bad integer literal: " + pos->text);
+    Node_id i = ast.add(Node_kind::integer,
+                                    static_cast<std::uint32_t>(value), line());
+    ast[i].flags = is_unsigned ? integer_unsigned : 0;
+    if (text[0] != '0')
+        ast[i].flags |= integer_decimal;
+    ++pos;
+    return i;
+}
+
+} // namespace fauces
+
+void fauces::parse_unit(list<Token>& tokens, Ast& ast)
+{
+    Parser {tokens, ast}.translation_unit();
+}
@@ -30,6 +30,189 @@ SOFTWARE.
 #ifndef phase7_hpp
 #define phase7_hpp
 
+#include "pieces.hpp"
 
+#include <list>
+#include <string>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace fauces
+{
+
+// Bump allocator for data that lives as long as the translation of a unit.
+// Nothing is freed until the whole arena is destroyed.
+class Arena
+{
+public:
+    static constexpr size_t block_size = 64 * 1024;
+    
+    void* allocate(size_t size, size_t alignment);
+    std::string_view store(std::string_view text);
+    
+    size_t size() const
+    {
+        return blocks.size() * block_size;
+    }
+private:
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::vector<std::unique_ptr<std::byte[]>> big_blocks;
+    size_t used = block_size;
+};
+
+// Nodes refer to each other by their index in the tree, which is much
+// smaller than a pointer and keeps all nodes together in memory. Index 0 is
+// never used by a node, so it can mean no node.
+using Node_id = std::uint32_t;
+constexpr Node_id no_node = 0;
+
+enum class Node_kind: std::uint8_t
+{
+    none,
+    translation_unit,
+    function,           // type, parameters..., compound
+    parameter,          // type
+    variable,           // type, initializer?
+    type,
+    compound,           // statements...
+    return_statement,   // expression?
+    if_statement,       // condition, statement, statement?
+    expression_statement,
+    integer,
+    name,
+    unary,              // operand
+    binary,             // left, right
+    subscript,          // array, index
+    call,               // function, arguments...
+    static_assertion    // expression
+};
+
+enum class Op: std::uint8_t
+{
+    none,
+    add, sub, mul, div, rem, shl, shr,
+    lt, gt, le, ge, eq, ne,
+    bit_and, bit_or, bit_xor, log_and, log_or,
+    assign,
+    neg, pos, log_not, bit_not, deref, address
+};
+
+enum class Base_type: std::uint8_t
+{
+    void_type,
+    char_type,
+    signed_char,
+    unsigned_char,
+    int_type,
+    unsigned_int
+};
+
+// Flags of nodes.
+enum: std::uint16_t
+{
+    type_const = 0x100,         // Pointer depth in the low byte
+    integer_unsigned = 1,
+    integer_decimal = 2,
+    declared_constexpr = 1      // Functions and variables
+};
+
+// Names, literal values and types are kept in value: see Ast::name_text().
+// The base type of a type node is also in value.
+struct Node
+{
+    Node_kind kind = Node_kind::none;
+    Op op = Op::none;
+    std::uint16_t flags = 0;
+    Node_id first = no_node;    // First child
+    Node_id next = no_node;     // Next sibling
+    std::uint32_t value = 0;
+};
+
+static_assert(sizeof(Node) == 16);
+
+// Abstract syntax tree of a translation unit. Nodes are stored contiguously
+// and released all together with the tree, along with the arena holding
+// the spelling of names. Nodes of a declaration come after those of the
+// declarations before it, so comparing them tells which comes first.
+class Ast
+{
+public:
+    Ast();
+    
+    Node_id add(Node_kind kind, std::uint32_t value, std::uint32_t line);
+    
+    Node& operator[](Node_id id)
+    {
+        return nodes[id];
+    }
+    
+    const Node& operator[](Node_id id) const
+    {
+        return nodes[id];
+    }
+    
+    Node_id root() const
+    {
+        return 1;
+    }
+    
+    std::uint32_t line(Node_id id) const
+    {
+        return lines[id];
+    }
+    
+    // Nodes added from now on come from the file at path.
+    void source(std::string_view path);
+    // As "path:line: ", for error messages.
+    std::string location(Node_id id) const;
+    
+    std::uint32_t name(std::string_view text);
+    std::string_view name_text(std::uint32_t name) const
+    {
+        return names[name];
+    }
+    
+    size_t size() const
+    {
+        return nodes.size() - 1;
+    }
+private:
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> lines;   // Kept apart: seldom used
+    // First node from each file, whenever the file changes
+    std::vector<std::pair<Node_id, std::string_view>> files;
+    std::vector<std::string_view> names;
+    std::unordered_map<std::string_view, std::uint32_t> name_ids;
+    Arena arena;
+};
+
+// Appends children to a node in order.
+class Child_list
+{
+public:
+    Child_list(Ast& ast, Node_id parent): ast {ast}, parent {parent} {}
+    
+    void add(Node_id child)
+    {
+        if (last == no_node)
+            ast[parent].first = child;
+        else
+            ast[last].next = child;
+        last = child;
+    }
+private:
+    Ast& ast;
+    Node_id parent;
+    Node_id last = no_node;
+};
+
+void parse_unit(std::list<Token>& tokens, Ast& ast);
+
+}
 
 #endif /* phase7_hpp */
@@ -33,4 +33,47 @@ SOFTWARE.
 
 // Phase 8 requires full implementation of Translator::instantiate
 
+auto fauces::canonical_spelling(const Specialization& spec) -> string
+{
+    string spelling = spec.template_name + "<";
+    for (auto i = spec.arguments.begin(); i != spec.arguments.end(); ++i)
+    {
+        if (i != spec.arguments.begin())
+            spelling += ",";
+        spelling += *i;
+    }
+    return spelling + ">";
+}
 
+auto fauces::instantiation_key(const string& canonical) -> Instantiation_key
+{
+    // 64-bit FNV-1a
+    Instantiation_key key = 0xcbf2'9ce4'8422'2325;
+    for (unsigned char c: canonical)
+    {
+        key ^= c;
+        key *= 0x0000'0100'0000'01b3;
+    }
+    return key & 0xffff'ffff'ffff'ffff;
+}
+
+bool fauces::Instantiation_cache::contains(const Specialization& spec) const
+{
+    string canonical = canonical_spelling(spec);
+    auto i = instantiations.find(instantiation_key(canonical));
+    if (i == instantiations.end())
+        return false;
+    if (i->second->specialization != canonical)
+        throw Instantiation_collision {canonical};
+    return true;
+}
+
+void fauces::Instantiation_cache::add
+            (const Specialization& spec, unique_ptr<Instantiation_unit> unit)
+{
+    string canonical = canonical_spelling(spec);
+    unit->specialization = canonical;
+    auto key = instantiation_key(canonical);
+    if (!instantiations.emplace(key, std::move(unit)).second)
+        throw Instantiation_collision {canonical};
+}
@@ -30,9 +30,11 @@ SOFTWARE.
 #include "phase9.hpp"
 
 #include "pieces.hpp"
+#include "arch.hpp"
 
+template<typename Arch>
 void
-fauces::Linked_program::
+fauces::Linked_program<Arch>::
 load_symbol
 (const string& name, const Symbol& symbol, const vector<unsigned char>& origin)
 {
@@ -42,12 +44,15 @@ load_symbol
     relocate_old_references(name, lsym);
 }
 
-auto fauces::Linked_program::
+template<typename Arch>
+auto fauces::Linked_program<Arch>::
 init_linked_symbol(const Symbol &symbol, const vector<unsigned char> &origin)
 -> Linked_symbol
 {
     Linked_symbol linked_symbol {symbol.pos, symbol.size, symbol.type};
     auto bytes = section_bytes(symbol.type);
+    while (bytes->size() % symbol.alignment)
+        bytes->push_back(0);
     linked_symbol.pos = bytes->size();
     auto sym_end = symbol.pos + symbol.size;
     for (auto i = symbol.pos; i != sym_end; ++i)
@@ -55,8 +60,9 @@ init_linked_symbol(const Symbol &symbol, const vector<unsigned char> &origin)
     return linked_symbol;
 }
 
+template<typename Arch>
 void
-fauces::Linked_program::
+fauces::Linked_program<Arch>::
 relocate_new_references(const Symbol& symbol, Linked_symbol& linked_symbol)
 {
     auto& refs = symbol.references_to_others;
@@ -78,8 +84,9 @@ relocate_new_references(const Symbol& symbol, Linked_symbol& linked_symbol)
     }
 }
 
+template<typename Arch>
 void
-fauces::Linked_program::
+fauces::Linked_program<Arch>::
 relocate_old_references(const string& name, const Linked_symbol& lsym)
 {
     if (ext_symbols.find(name) != ext_symbols.end())
@@ -100,29 +107,19 @@ relocate_old_references(const string& name, const Linked_symbol& lsym)
     }
 }
 
+template<typename Arch>
 void
-fauces::Linked_program::
+fauces::Linked_program<Arch>::
 relocate
 (const Linked_symbol& caller,const Linked_symbol& called, const Reference& ref)
 {
     auto bytes = section_bytes(caller.type);
-    unique_ptr<Relocate> reloc;
-    switch (ref.type)
-    {
-        case Ref_type::two_bytes:
-            reloc = make_unique<Relocate_two_bytes>();
-            break;
-        case Ref_type::four_halfbytes:
-            reloc = make_unique<Relocate_four_halfbytes>();
-            break;
-        default:
-            throw Ref_type_bad();
-    }
-    reloc->change_loc(*bytes, caller.pos + ref.pos, called.pos);
+    relocate_reference<Arch>(ref.type, *bytes, caller.pos + ref.pos, called.pos);
 }
 
+template<typename Arch>
 auto
-fauces::Linked_program::
+fauces::Linked_program<Arch>::
 section_bytes(Sym_type type) -> vector<unsigned char>*
 {
     switch (type)
@@ -138,22 +135,40 @@ section_bytes(Sym_type type) -> vector<unsigned char>*
     }
 }
 
-void
+// Every supported architecture must be listed here.
+template struct fauces::Linked_program<fauces::arch::Visy>;
+
+auto
 fauces::Supply::
-add_symbol(Linked_program& prog, const string &symbol_name)
+find_symbol(const string &symbol_name) -> Symbol_source
 {
+    Symbol_source source;
     for (auto i = units.begin(); i != units.end(); ++i)
     {
-        auto& symbols = (*i)->symbols;
-        auto j = symbols.find(symbol_name);
-        if (j != symbols.end() && !j->second.is_external())
-        {
-            auto& sym = j->second;
-            auto& bytes = sym.type == Sym_type::code ? (*i)->code : (*i)->data;
-            prog.load_symbol(symbol_name, sym, bytes);
-            return;
-        }
+        if (find_symbol(symbol_name, **i, source))
+            return source;
+    }
+    for (auto& i: instantiations.units())
+    {
+        if (find_symbol(symbol_name, *i.second, source))
+            return source;
     }
     throw Ref_unresolved {symbol_name};
 }
 
+bool
+fauces::Supply::
+find_symbol(const string &symbol_name, Translated_unit& unit,
+                                                        Symbol_source& source)
+{
+    auto& symbols = unit.symbols;
+    auto j = symbols.find(symbol_name);
+    if (j != symbols.end() && !j->second.is_external())
+    {
+        auto& sym = j->second;
+        source.symbol = &sym;
+        source.bytes = sym.type == Sym_type::code ? &unit.code : &unit.data;
+        return true;
+    }
+    return false;
+}
@@ -30,13 +30,18 @@ SOFTWARE.
 
 #include "phase4.hpp"
 
-auto fauces::Preprocessor::preprocess(const string& path, size_t level)
+auto fauces::Preprocessor::preprocess
+            (const string& path, std::vector<string>& sources, size_t level)
     -> list<Token>
 {
     if (level > max_include)
         throw Limit_error {"Included file is too nested"};
-    list<Token> tokens = pretokenize(path);
-    execute_directives(tokens, level);
+    Preprocessing_state state;
+    string key = include_key(path);
+    list<Token> tokens = pretokenize(key, state.guards[key]);
+    state.sources.push_back(key);
+    execute_directives(tokens, state, level);
+    sources = std::move(state.sources);
     convert_literals(tokens);
     concatenate_literals(tokens);
     return tokens;
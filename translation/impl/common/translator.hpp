@@ -30,9 +30,20 @@ SOFTWARE.
 #define translator_hpp
 
 #include "pieces.hpp"
+#include "phase7.hpp"
+#include "evaluator.hpp"
 #include <list>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <vector>
+#include <algorithm>
 
 namespace fauces
 {
@@ -42,40 +53,126 @@ using std::unique_ptr;
 
 void remove_white_space(list<Token>& tokens);
 void bad_token(size_t index, const Token& token);
+string canonical_spelling(const Specialization& spec);
+Instantiation_key instantiation_key(const string& canonical);
+
+// What makes a file unnecessary to read when it is included again.
+struct Include_guard
+{
+    bool once = false;  // #pragma once
+    string macro;       // Macro of the #ifndef wrapping the whole file
+};
+
+struct Preprocessing_state;
 
 class Preprocessor
 {
+    friend class Include_prefetcher;
 public:
     static constexpr size_t max_include = 256;
-    static list<Token> preprocess(const string& path, size_t level = 0);
+    static list<Token> preprocess(const string& path,
+                                std::vector<string>& sources, size_t level = 0);
+    static string include_key(const string& path);
+    
+    // Files at least this big are lexed in chunks, by lexing_threads threads.
+    // The tokens are the same as when lexing with a single thread.
+    static constexpr size_t parallel_lexing_size = 1 << 20;
+    static inline unsigned lexing_threads =
+                            std::max(std::thread::hardware_concurrency(), 1u);
+    static list<Token> lex(const string& path, unsigned threads);
 private:
-    static std::list<Token> pretokenize(const string& path);
-    static void execute_directives(list<Token>& tokens, size_t level = 0);
+    static std::list<Token> pretokenize(const string& path,
+                                                        Include_guard& guard);
+    static void execute_directives(list<Token>& tokens,
+                                Preprocessing_state& state, size_t level = 0);
     static void convert_literals(list<Token>& tokens);
     static void concatenate_literals(list<Token>& tokens);
 };
 
+// Pretokenizes, on an I/O thread, files that are going to be included, so
+// that phase 4 rarely has to wait for them. The files requested last are
+// pretokenized first, because they are included by the innermost file.
+class Include_prefetcher
+{
+public:
+    Include_prefetcher() = default;
+    Include_prefetcher(const Include_prefetcher&) = delete;
+    Include_prefetcher& operator=(const Include_prefetcher&) = delete;
+    ~Include_prefetcher();
+    
+    void prefetch(const std::vector<string>& paths);
+    list<Token> take(const string& path, Include_guard& guard);
+private:
+    struct Prefetched_file
+    {
+        list<Token> tokens;
+        string guard_macro;
+    };
+    
+    std::mutex mutex;
+    std::condition_variable wanted;
+    std::deque<string> queue;
+    std::unordered_map<string, std::future<Prefetched_file>> started;
+    std::unordered_set<string> queued;
+    std::thread worker;
+    bool stop = false;
+    
+    void work();
+};
+
+// State of phase 4 shared by a source file and every file it includes.
+struct Preprocessing_state
+{
+    std::unordered_set<string> macros;
+    std::unordered_map<string, Include_guard> guards;
+    std::vector<string> sources;
+    Include_prefetcher prefetcher;
+};
+
 template<typename Arch>
 class Translator: public Translated_unit_loader
 {
 public:
-    Translator(const string& path) : path {path} {}
+    Translator(const string& path, Instantiation_cache& instantiations) :
+    path {path}, instantiations {instantiations}
+    {}
+    
+    static void instantiate(Translated_unit& unit,
+                                            Instantiation_cache& instantiations)
+    {
+        // Specializations already generated for another unit are not
+        // generated again: the unit just keeps its references to them.
+        // The list is kept, so that a copy of the unit can be instantiated
+        // again for another supply.
+        for (auto& spec: unit.specializations)
+        {
+            if (!instantiations.contains(spec))
+                instantiations.add(spec, generate(spec));
+        }
+    }
 private:
     const string path;
+    Instantiation_cache& instantiations;
     unique_ptr<Translated_unit> load() override
     {
-        list<Token> tokens = preprocess(path);
         auto unit = make_unique<Translated_unit>();
-        analyze(tokens, *unit);
-        instantiate(*unit);
+        list<Token> tokens = preprocess(path, unit->sources);
+        {
+            // The tree goes away, all at once, as soon as the unit is done.
+            Ast ast;
+            analyze(tokens, ast, *unit);
+        }
+        Arch::optimize(*unit);
+        instantiate(*unit, instantiations);
         return unit;
     }
-    static list<Token> preprocess(const string& path, size_t level = 0)
+    static list<Token> preprocess(const string& path,
+                                std::vector<string>& sources, size_t level = 0)
     {
-        return Preprocessor::preprocess(path, level);
+        return Preprocessor::preprocess(path, sources, level);
     }
     
-    static void analyze(list<Token>& tokens, Translated_unit& unit)
+    static void analyze(list<Token>& tokens, Ast& ast, Translated_unit& unit)
     {
         size_t n = 0;
         remove_white_space(tokens);
@@ -85,13 +182,15 @@ private:
                 bad_token(n, t);
             ++n;
         }
-        throw Syntax_error {"No syntax defined yet: everything is an error"};
+        parse_unit(tokens, ast);
+        check_constants(ast, Arch::integers);
+        throw Syntax_error {"Code generation not supported yet"};
     }
 
-    static void instantiate(Translated_unit& unit)
+    static unique_ptr<Instantiation_unit> generate(const Specialization& spec)
     {
-        // Templates not supported yet.
-        // For the time being, this acts like a no-op.
+        throw Syntax_error {"Templates not supported yet: " +
+                                                    canonical_spelling(spec)};
     }
 };
 }
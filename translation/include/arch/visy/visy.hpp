@@ -29,11 +29,39 @@ SOFTWARE.
 #ifndef arch_visy_hpp
 #define arch_visy_hpp
 
+#include "pieces.hpp"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
 namespace fauces::arch
 {
 
+// Descriptor of our virtual system, known at compile time by everything
+// templated on the architecture.
 class Visy
 {
+public:
+    static constexpr unsigned address_bits = 16;
+    static constexpr Endianness endianness = Endianness::big;
+    static constexpr Size section_alignment = 2;
+    static constexpr std::array<Ref_type, 2> ref_types
+    {
+        Ref_type::two_bytes,
+        Ref_type::four_halfbytes
+    };
+    static constexpr std::uint_least16_t fo16_cpu = 0;
+    static constexpr Integer_model integers {8, 16, true};
+
+    static void optimize(Translated_unit& unit);
+    
+    // Improvements across units, before linking them
+    static void optimize_program(std::vector<Translated_unit*>& units);
+    
+    // Routines called for the arithmetic Visy lacks, to be linked with
+    // programs that use it
+    static std::unique_ptr<Translated_unit> language_library();
 };
 
 }
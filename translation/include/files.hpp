@@ -33,6 +33,8 @@ SOFTWARE.
 #include <string>
 #include <unordered_map>
 #include <iostream>
+#include <sstream>
+#include <filesystem>
 
 #include "pieces.hpp"
 #include "translator.hpp"
@@ -62,6 +64,7 @@ struct Program_input
 struct Program_output
 {
     std::string value;
+    std::string dep_file;   // Make rule listing the files read, if not empty
 };
 
 struct File_error_cantopen {};
@@ -73,8 +76,73 @@ enum class File_type {fo16, cpp};
 
 File_type identify_file_type(string filename);
 
+// Identity of the contents of a file, as far as we can tell without reading
+// it.
+struct File_stamp
+{
+    std::filesystem::file_time_type time;
+    std::uintmax_t size;
+    
+    bool operator==(const File_stamp& other) const
+    {
+        return time == other.time && size == other.size;
+    }
+};
+
+File_stamp file_stamp(string filename);
+
+// Writes a Make rule stating that the output depends on every source, so
+// that it is only translated again when one of them changes. The file is
+// replaced atomically.
+void save_dependencies(const Program_output& output,
+                                            const std::vector<string>& sources);
+
+// Units already loaded, kept across several supplies by long-lived processes.
+// A unit is loaded again only when the stamp of any file read to produce it
+// changes, and only a copy of it is given to each supply, because linking
+// consumes units. What loading a unit writes to the standard output is kept
+// with it and written again on every hit, so that the output is the same as
+// without a cache.
+class Unit_cache
+{
+public:
+    template<typename Arch>
+    unique_ptr<Translated_unit> load(const Program_input& input, Supply& supply);
+    
+    // A copy of the language library of Arch, which is only built the first
+    // time. A cache serves a single architecture.
+    template<typename Arch>
+    unique_ptr<Translated_unit> language_library()
+    {
+        if (!library)
+            library = Arch::language_library();
+        return make_unique<Translated_unit>(*library);
+    }
+    
+    void clear()
+    {
+        entries.clear();
+        library.reset();
+    }
+
+private:
+    struct Entry
+    {
+        std::vector<std::pair<string, File_stamp>> stamps;
+        unique_ptr<Translated_unit> unit;
+        string printed;     // By the loader
+    };
+    
+    unordered_map<string, Entry> entries;
+    unique_ptr<Translated_unit> library;
+    
+    static Entry new_entry(unique_ptr<Translated_unit> unit, string printed);
+    static bool is_current(const Entry& entry);
+};
+
 template<typename Arch>
-void add_to_supply(Supply& supply, const Program_input& input)
+unique_ptr<Translated_unit> load_unit
+                                (const Program_input& input, Supply& supply)
 {
     File_type type = identify_file_type(input.value);
     unique_ptr<Translated_unit_loader> loader;
@@ -84,19 +152,70 @@ void add_to_supply(Supply& supply, const Program_input& input)
             loader = make_unique<Fo16_unit_loader>(input.value);
             break;
         case File_type::cpp:
-            loader = make_unique<Translator<Arch>>(input.value);
+            loader = make_unique<Translator<Arch>>(input.value,
+                                                supply.instantiation_cache());
             break;
         default:
             throw File_error_unknown();
     }
-    supply.add_unit(loader->load());
+    return loader->load();
+}
+
+template<typename Arch>
+void add_to_supply(Supply& supply, const Program_input& input)
+{
+    supply.add_unit(load_unit<Arch>(input, supply));
+}
+
+template<typename Arch>
+void add_to_supply(Supply& supply, const Program_input& input,
+                                                            Unit_cache& cache)
+{
+    supply.add_unit(cache.load<Arch>(input, supply));
+}
+
+template<typename Arch>
+unique_ptr<Translated_unit> Unit_cache::load
+                                (const Program_input& input, Supply& supply)
+{
+    // Sources are spelled relative to the working directory, so units loaded
+    // from different directories are kept apart.
+    string key = std::filesystem::current_path().string() + '\0' + input.value;
+    auto i = entries.find(key);
+    if (i == entries.end() || !is_current(i->second))
+    {
+        std::ostringstream printed;
+        std::streambuf* cout_buffer = std::cout.rdbuf(printed.rdbuf());
+        unique_ptr<Translated_unit> unit;
+        try
+        {
+            unit = load_unit<Arch>(input, supply);
+        }
+        catch (...)
+        {
+            std::cout.rdbuf(cout_buffer);
+            std::cout << printed.str();
+            throw;
+        }
+        std::cout.rdbuf(cout_buffer);
+        std::cout << printed.str();
+        auto copy = make_unique<Translated_unit>(*unit);
+        entries.insert_or_assign(key, new_entry(std::move(unit),
+                                                            printed.str()));
+        return copy;
+    }
+    std::cout << i->second.printed;
+    // The instantiations generated when the unit was loaded went away with
+    // the supply that received them, so they are required again.
+    auto copy = make_unique<Translated_unit>(*i->second.unit);
+    Translator<Arch>::instantiate(*copy, supply.instantiation_cache());
+    return copy;
 }
 
 template<typename Arch>
-void save_program(Linked_program& prog, const Program_output& output)
+void save_program(Linked_program<Arch>& prog, const Program_output& output)
 {
-    Fo16_program_saver fo16_saver {output.value};
-    Linked_program_saver& saver = fo16_saver;
+    Fo16_program_saver<Arch> saver {output.value};
     saver.save(prog);
 }
 
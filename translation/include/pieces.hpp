@@ -30,8 +30,6 @@ SOFTWARE.
 #ifndef pieces_hpp
 #define pieces_hpp
 
-#include "arch.hpp"
-
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -39,6 +37,7 @@ SOFTWARE.
 #include <memory>
 #include <cstddef>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 
 namespace fauces
@@ -63,6 +62,20 @@ enum class Ref_type
     four_halfbytes
 };
 
+enum class Endianness
+{
+    big,
+    little
+};
+
+// Sizes of the fundamental integer types of an architecture, in bits.
+struct Integer_model
+{
+    unsigned char_bits;
+    unsigned int_bits;
+    bool char_is_signed;
+};
+
 struct Reference
 {
     Ref_type type;
@@ -104,17 +117,29 @@ struct Source_location
 
 struct Source_context
 {
-    std::ifstream is;
+    std::unique_ptr<std::istream> stream;
+    std::istream& is;
     u32string line;
     Source_location src;
     size_t line_start = 0;
     bool literal = false;
 
     Source_context(const string& path) :
+    stream {make_unique<std::ifstream>()},
+    is {*stream},
     src {path}
     {
         is.exceptions(is.failbit | is.badbit | is.eofbit);
-        is.open(path, is.binary);
+        static_cast<std::ifstream&>(is).open(path, is.binary);
+    }
+    
+    // Part of a source file already in memory, starting at src.
+    Source_context(string content, const Source_location& src) :
+    stream {make_unique<std::istringstream>(std::move(content))},
+    is {*stream},
+    src {src}
+    {
+        is.exceptions(is.failbit | is.badbit | is.eofbit);
     }
 };
 
@@ -146,6 +171,7 @@ struct Ref_unresolved {string symbol_name;};
 struct Prog_nocode {};
 struct Prog_toobig {};
 struct Syntax_error {string msg;};
+struct Unterminated_comment: Syntax_error {};
 struct Unget_error {};
 struct Limit_error {string msg;};
 
@@ -157,6 +183,7 @@ struct Symbol
     std::vector<Reference> references_in_code;
     std::vector<Reference> references_in_data;
     std::unordered_map<string, std::vector<Reference>> references_to_others;
+    Size alignment = 1;     // Of its final location, in bytes
     bool is_external()
     {
         return pos == 0 && size == 0;
@@ -173,6 +200,9 @@ struct Linked_symbol
 
 struct Translated_unit_error {};
 
+// A program being linked for a particular architecture. Arch describes the
+// target at compile time: see arch::Visy for the members it must provide.
+template<typename Arch>
 struct Linked_program
 {
     
@@ -193,17 +223,24 @@ struct Linked_program
         return data;
     }
     
+    // Every symbol placed, by name
+    const std::unordered_map<string, Linked_symbol>& symbols()
+    {
+        return int_symbols;
+    }
+    
     void verify()
     {
+        constexpr size_t max_size = size_t {1} << Arch::address_bits;
         if (ext_symbols.size())
             throw Ref_unresolved();
         if (!code.size())
             throw Prog_nocode();
-        if (code.size() % 2)
+        while (code.size() % Arch::section_alignment)
             code.push_back(0);
-        if (data.size() % 2)
-            code.push_back(0);
-        if (code.size() > 65536 || data.size() > 65536)
+        while (data.size() % Arch::section_alignment)
+            data.push_back(0);
+        if (code.size() > max_size || data.size() > max_size)
             throw Prog_toobig();
     }
     
@@ -224,11 +261,10 @@ private:
         (const string& name, const Linked_symbol& lsym);
 };
 
-class Linked_program_saver
+struct Specialization
 {
-public:
-    virtual void save(Linked_program& prog) = 0;
-    virtual ~Linked_program_saver() = default;
+    string template_name;
+    std::vector<string> arguments;
 };
 
 struct Translated_unit
@@ -236,6 +272,8 @@ struct Translated_unit
     std::vector<unsigned char> code;
     std::vector<unsigned char> data;
     std::unordered_map<string, Symbol> symbols;
+    std::vector<Specialization> specializations;
+    std::vector<string> sources;    // Files read to produce the unit
 };
 
 class Translated_unit_loader
@@ -245,7 +283,39 @@ public:
     virtual ~Translated_unit_loader() = default;
 };
 
-using Instantiation_unit = Translated_unit;
+using Instantiation_key = std::uint_least64_t;
+
+struct Instantiation_collision {string specialization;};
+
+struct Instantiation_unit: Translated_unit
+{
+    string specialization;
+};
+
+// Instantiations shared by every unit in a supply. Each specialization is
+// generated once, no matter how many translation units require it, and it is
+// looked up by the hash of its canonical spelling.
+class Instantiation_cache
+{
+public:
+    bool contains(const Specialization& spec) const;
+    void add(const Specialization& spec, unique_ptr<Instantiation_unit> unit);
+    
+    const unordered_map<Instantiation_key, unique_ptr<Instantiation_unit>>&
+    units() const
+    {
+        return instantiations;
+    }
+    
+    void clear()
+    {
+        instantiations.clear();
+    }
+
+private:
+    unordered_map<Instantiation_key, unique_ptr<Instantiation_unit>>
+                                                                instantiations;
+};
 
 class Supply
 {
@@ -255,15 +325,49 @@ public:
         units.push_back(std::move(unit));
     }
     
+    // Every file read to produce the units in the supply, without repetitions.
+    std::vector<string> sources() const
+    {
+        std::vector<string> all;
+        for (auto& unit: units)
+        {
+            for (auto& source: unit->sources)
+            {
+                if (std::find(all.begin(), all.end(), source) == all.end())
+                    all.push_back(source);
+            }
+        }
+        return all;
+    }
+    
+    Instantiation_cache& instantiation_cache()
+    {
+        return instantiations;
+    }
+    
     void clear()
     {
         units.clear();
+        instantiations.clear();
+    }
+    
+    // Link-time optimization: lets the architecture improve the code of all
+    // the units together, while they can still be changed.
+    template<typename Arch>
+    void optimize_program()
+    {
+        std::vector<Translated_unit*> all;
+        for (auto& unit: units)
+            all.push_back(unit.get());
+        for (auto& [key, unit]: instantiations.units())
+            all.push_back(unit.get());
+        Arch::optimize_program(all);
     }
     
     template<typename Arch>
-    Linked_program link()
+    Linked_program<Arch> link()
     {
-        Linked_program prog;
+        Linked_program<Arch> prog;
         add_start(prog);
         while (prog.pending_symbols().size())
         {
@@ -276,13 +380,30 @@ public:
 
 private:
     std::vector<std::unique_ptr<Translated_unit>> units;
+    Instantiation_cache instantiations;
     
-    void add_start(Linked_program& prog)
+    struct Symbol_source
+    {
+        const Symbol* symbol;
+        const std::vector<unsigned char>* bytes;
+    };
+    
+    template<typename Arch>
+    void add_start(Linked_program<Arch>& prog)
     {
         add_symbol(prog, "_start");
     }
     
-    void add_symbol(Linked_program& prog, const string& symbol_name);
+    template<typename Arch>
+    void add_symbol(Linked_program<Arch>& prog, const string& symbol_name)
+    {
+        Symbol_source source = find_symbol(symbol_name);
+        prog.load_symbol(symbol_name, *source.symbol, *source.bytes);
+    }
+    
+    Symbol_source find_symbol(const string& symbol_name);
+    bool find_symbol(const string& symbol_name, Translated_unit& unit,
+                                                        Symbol_source& source);
 };
 
 template<typename T>
@@ -291,32 +412,41 @@ bool within(T thing, T begin, T size)
     return thing >= begin && thing < begin + size;
 }
 
-class Relocate
-{
-public:
-    virtual
-    void change_loc
-        (std::vector<unsigned char>& dst, Location pos, Location new_ref) = 0;
-    virtual ~Relocate() = default;
-};
+// Relocators patch a reference with the final location of the symbol it
+// refers to. There is one for each reference type, and each architecture
+// lists the ones it supports.
+template<Ref_type type, typename Arch>
+struct Relocate;
 
-class Relocate_two_bytes: public Relocate
+template<typename Arch>
+struct Relocate<Ref_type::two_bytes, Arch>
 {
-    void change_loc
+    static void change_loc
         (std::vector<unsigned char>& dst, Location pos, Location new_ref)
-        override
     {
-        dst.at(pos) = (new_ref >> 8) & 0xff;
-        dst.at(pos + 1) = new_ref & 0xff;
+        static_assert(Arch::address_bits == 16);
+        unsigned char high = (new_ref >> 8) & 0xff;
+        unsigned char low = new_ref & 0xff;
+        if constexpr (Arch::endianness == Endianness::big)
+        {
+            dst.at(pos) = high;
+            dst.at(pos + 1) = low;
+        }
+        else
+        {
+            dst.at(pos) = low;
+            dst.at(pos + 1) = high;
+        }
     }
 };
 
-class Relocate_four_halfbytes: public Relocate
+template<typename Arch>
+struct Relocate<Ref_type::four_halfbytes, Arch>
 {
-    void change_loc
+    static void change_loc
         (std::vector<unsigned char>& dst, Location pos, Location new_ref)
-        override
     {
+        static_assert(Arch::address_bits == 16);
         constexpr unsigned char mask = 0b0001'1110;
         auto& b3 = dst.at(pos);
         auto& b2 = dst.at(pos + 1);
@@ -329,6 +459,20 @@ class Relocate_four_halfbytes: public Relocate
     }
 };
 
+// Chooses the relocator for a reference among the ones supported by Arch.
+// Other reference types are an error.
+template<typename Arch, size_t i = 0>
+void relocate_reference(Ref_type type,
+                std::vector<unsigned char>& dst, Location pos, Location new_ref)
+{
+    if constexpr (i == Arch::ref_types.size())
+        throw Ref_type_bad();
+    else if (type == Arch::ref_types[i])
+        Relocate<Arch::ref_types[i], Arch>::change_loc(dst, pos, new_ref);
+    else
+        relocate_reference<Arch, i + 1>(type, dst, pos, new_ref);
+}
+
 } // namespace fauces
 
 #endif /* pieces_hpp */